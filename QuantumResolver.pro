@@ -1,5 +1,5 @@
 TEMPLATE = app
-CONFIG += console c++2a
+CONFIG += console c++2a thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
@@ -20,8 +20,10 @@ DISTFILES += \
 
 SOURCES += \
     src/cli/cli_interface.cpp \
+    src/cli/daemon.cpp \
     src/cli/table_print.cpp \
     src/cli/format_utils.cpp \
+    src/core/atom_table.cpp \
     src/core/ebuild.cpp \
     src/core/ebuild_version.cpp \
     src/core/package.cpp \
@@ -32,13 +34,18 @@ SOURCES += \
     src/quantum.cpp \
     src/resolver.cpp \
     src/utils/file_utils.cpp \
+    src/utils/io_uring.cpp \
     src/utils/misc_utils.cpp \
-    src/utils/string_utils.cpp
+    src/utils/sat_solver.cpp \
+    src/utils/string_utils.cpp \
+    src/utils/thread_utils.cpp
 
 HEADERS += \
     include/quantum-resolver/cli/cli_interface.h \
+    include/quantum-resolver/cli/daemon.h \
     include/quantum-resolver/cli/table_print.h \
     include/quantum-resolver/cli/format_utils.h \
+    include/quantum-resolver/core/atom_table.h \
     include/quantum-resolver/core/ebuild.h \
     include/quantum-resolver/core/ebuild_version.h \
     include/quantum-resolver/core/package.h \
@@ -48,9 +55,17 @@ HEADERS += \
     include/quantum-resolver/database.h \
     include/quantum-resolver/resolver.h \
     include/quantum-resolver/utils/bijection.h \
+    include/quantum-resolver/utils/chunked_vector.h \
     include/quantum-resolver/utils/concepts.h \
+    include/quantum-resolver/utils/concurrent_interner.h \
+    include/quantum-resolver/utils/dynamic_bitset.h \
     include/quantum-resolver/utils/file_utils.h \
+    include/quantum-resolver/utils/io_uring.h \
     include/quantum-resolver/utils/misc_utils.h \
     include/quantum-resolver/utils/multikey_map.h \
     include/quantum-resolver/utils/named_vector.h \
-    include/quantum-resolver/utils/string_utils.h
+    include/quantum-resolver/utils/pipeline.h \
+    include/quantum-resolver/utils/sat_solver.h \
+    include/quantum-resolver/utils/serialization.h \
+    include/quantum-resolver/utils/string_utils.h \
+    include/quantum-resolver/utils/thread_utils.h
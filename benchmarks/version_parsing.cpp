@@ -0,0 +1,72 @@
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "quantum-resolver/core/ebuild_version.h"
+
+using namespace std;
+
+// Version strings the way they show up in the md5-cache, in installed packages and in atoms
+const vector<string> versions =
+{
+    "1", "0.1", "2.38", "1.2.13", "9999", "5.9999", "3.11.4", "12.2.1_p20230121-r1",
+    "1.0_alpha", "4.0_beta3", "2.6.0_pre20230101", "7.0_rc2-r3", "1.1.1w", "3.0.9-r2",
+    "2.4.57", "0.8.3_p4", "10.3.1_p20211126", "6.1.0-r1", "1.2b_p1", "20230311",
+    "1.22.12", "118.0.5993.88", "0.15.2_p20221021-r12", "2023.03.0", "1.2.3.4.5"
+};
+
+// The regex that EbuildVersion::set_version() used to validate every version string with,
+// before reading it a second time to build its key
+const regex ver_regexp("^(\\d+)((\\.\\d+)*)([a-z]?)((_(pre|p|beta|alpha|rc)\\d*)*)(-r(\\d+))?$");
+
+/// \brief parses every version 'iterations' times with 'parse_version', prints how long it took
+template <class Func>
+void time_parsing(const string &name, size_t iterations, Func &&parse_version)
+{
+    EbuildVersion version;
+    size_t live_count = 0;
+
+    auto start = chrono::high_resolution_clock::now();
+
+    for(size_t i = 0 ; i < iterations ; i++)
+    {
+        for(const string &ver: versions)
+        {
+            parse_version(version, ver);
+            live_count += version.is_live();
+        }
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+
+    const size_t parsed = iterations * versions.size();
+    const double total_ns = chrono::duration<double, nano>(end - start).count();
+
+    cout << name << ": parsed " << parsed << " versions (" << live_count << " live) in : "
+         << size_t(total_ns / 1e6) << "ms" << endl;
+    cout << name << ": per version : " << total_ns / parsed << "ns" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    // usage: version_parsing [iterations]
+    const size_t iterations = argc > 1 ? stoul(argv[1]) : 200000;
+
+    // baseline: the regex check in front of the scanner, as set_version() was before the scanner
+    // validated the strings itself
+    time_parsing("regex + scanner", iterations, [](EbuildVersion &version, const string &ver)
+    {
+        if(not regex_match(ver, ver_regexp))
+            throw runtime_error("Version string of invalid format : " + ver);
+        version.set_version(ver);
+    });
+
+    time_parsing("scanner", iterations, [](EbuildVersion &version, const string &ver)
+    {
+        version.set_version(ver);
+    });
+
+    return 0;
+}
@@ -5,10 +5,14 @@
 class CommandLineInterface
 {
 public:
-    CommandLineInterface(std::vector<std::string> input);
+    CommandLineInterface(Database &db);
+
+    /// \brief runs the command given on the command line, e.g. {"status", "sys-devel/gcc"}
+    void run(const std::vector<std::string> &input);
 
     void print_pkg_status(const std::string &package_constraint_str);
+    void resolve(const std::vector<std::string> &atom_strs);
 
 protected:
-    Database db;
+    Database &db;
 };
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "quantum-resolver/database.h"
+
+/// \brief keeps the Database resident and answers the commands of the command line
+///        over a Unix domain socket, refreshing it when inotify reports changes on disk
+/// \note  a client sends its arguments each followed by a '\0' then shuts down its
+///        writing side, the daemon writes back what `quantum` would have printed
+class Daemon
+{
+public:
+    /// \brief loads the database and starts watching the md5-cache, profiles, /etc/portage,
+    ///        /var/db/pkg and the world file
+    Daemon();
+    ~Daemon();
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    /// \brief answers the clients until the process is killed
+    void serve();
+
+    /// \brief where the socket lives, can be overridden with the QUANTUM_SOCKET environment variable
+    static std::filesystem::path socket_path();
+
+    /// \brief client side: has a running daemon execute 'input', its answer goes to stdout
+    /// \return false if no daemon listens on socket_path(), or if it runs as another user than us or root
+    static bool forward(const std::vector<std::string> &input);
+
+protected:
+    /// \brief adds an inotify watch on 'dir', and on its subfolders down to 'depth' levels
+    void watch(const std::filesystem::path &dir, int depth, bool source = false);
+    void watch_sources();
+
+    /// \brief drains the pending inotify events, watching the folders created under watched ones
+    void read_events();
+
+    /// \brief applies the pending changes: the /var/db/pkg entries one by one,
+    ///        the rest through Database::refresh()
+    void refresh();
+    bool has_pending_changes() const { return dirty or not installed_entries.empty(); }
+
+    /// \brief answers one client on the daemon's thread, the next ones wait in the listen backlog
+    void answer(int client_fd);
+
+    Database db;
+
+    int listen_fd = -1;
+    int inotify_fd = -1;
+
+    struct Watch
+    {
+        std::filesystem::path dir;
+        int depth;
+        bool source; // added by watch_sources() rather than found under another watch
+    };
+    std::unordered_map<int, Watch> watches;
+
+    /// \brief set by inotify events, the database is refreshed before answering anyone
+    bool dirty = false;
+
+    /// \brief /var/db/pkg entries that changed, e.g. {"sys-devel", "gcc-12.2.1"},
+    ///        they are applied without refreshing the whole database
+    std::set<std::pair<std::string, std::string>> installed_entries;
+
+    /// \brief a watched source folder got removed, they are watched again before refreshing
+    bool lost_watches = false;
+};
@@ -86,13 +86,22 @@ pretty_format_flags(
         return result;
     };
 
+    auto without_expand_flags = [&useflags](const unordered_set<FlagID>& flags)
+    {
+        unordered_set<FlagID> filtered;
+        for(FlagID flag: flags)
+            if(not useflags.get_expand_flags().contains(flag))
+                filtered.insert(flag);
+        return filtered;
+    };
+
     std::map<std::string, std::vector<std::string>> pretty_stuff;
 
-    auto&& enabled_formatting = format_flag(enabled - useflags.get_expand_flags(), true);
+    auto&& enabled_formatting = format_flag(without_expand_flags(enabled_set), true);
     if(not enabled_formatting.empty())
         std::ranges::move(std::move(enabled_formatting), std::back_inserter(pretty_stuff["USE"]));
 
-    auto&& disabled_formatting = format_flag(disabled - useflags.get_expand_flags(), false);
+    auto&& disabled_formatting = format_flag(without_expand_flags(disabled_set), false);
     if(not disabled_formatting.empty())
         std::ranges::move(std::move(disabled_formatting), std::back_inserter(pretty_stuff["USE"]));
 
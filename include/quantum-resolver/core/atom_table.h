@@ -0,0 +1,57 @@
+#ifndef ATOM_TABLE_H
+#define ATOM_TABLE_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include "quantum-resolver/core/parser.h"
+#include "quantum-resolver/utils/chunked_vector.h"
+#include "quantum-resolver/utils/concurrent_interner.h"
+#include "quantum-resolver/utils/serialization.h"
+
+class Database;
+
+using AtomID = std::size_t;
+
+/// \brief every distinct atom of the dependency strings, e.g. ">=dev-lang/python-3.11:3.11[ssl]",
+///        parsed once and shared by all the dependency trees that name it
+/// \note  insert() can be called from several threads at once, the atoms it returns
+///        are fully parsed by the time any thread can see their ID
+class AtomTable
+{
+public:
+    AtomTable(Database *db);
+
+    /// \brief ID of 'atom_str', parsed the first time it is seen
+    AtomID insert(std::string_view atom_str);
+
+    const PackageDependency& operator [](AtomID atom_id) const { return atoms[atom_id]; }
+    const std::string& get_atom_str(AtomID atom_id) const { return atom_strs.name(atom_id); }
+    std::size_t size() const { return atom_strs.size(); }
+
+    /// \brief parses again the atoms that named a package or a flag that did not exist yet
+    /// \return the number of atoms that changed
+    /// \note  not thread-safe, meant for Repo::refresh()
+    std::size_t reparse_unresolved_atoms();
+
+    void serialize(BinaryWriter &writer) const;
+    void deserialize(BinaryReader &reader);
+
+    /// \brief throws std::runtime_error if an atom names a package or a flag that does not exist,
+    ///        i.e. if the snapshot it has been read from is corrupted
+    void check_ids() const;
+
+    constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+protected:
+    static bool is_resolved(const PackageDependency &atom);
+
+    ConcurrentInterner atom_strs;
+    ChunkedVector<PackageDependency> atoms; // indexed by AtomID
+
+    Database *db;
+};
+
+#endif // ATOM_TABLE_H
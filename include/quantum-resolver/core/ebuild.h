@@ -2,23 +2,172 @@
 #define EBUILD_H
 
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <optional>
 #include <limits>
+#include <cstdint>
+#include <vector>
 
 #include "quantum-resolver/core/ebuild_version.h"
 #include "quantum-resolver/utils/named_vector.h"
 #include "quantum-resolver/core/parser.h"
 #include "quantum-resolver/core/useflags.h"
+#include "quantum-resolver/utils/file_utils.h"
 
 
 enum struct DependencyType {BUILD, RUNTIME};
 
+/// \brief a node of a dependency tree, see Dependencies
+struct DependencyNode
+{
+    enum struct Type : std::uint8_t {PACKAGE, ALL_OF, ANY_OF, EXACTLY_ONE_OF, AT_MOST_ONE_OF, USE_CONDITION};
+
+    Type type;
+    bool flag_state = true; // USE_CONDITION: the group applies when the flag is in this state
+    std::uint32_t end = 0; // index of the node that follows this node's subtree
+    std::uint32_t payload = 0; // PACKAGE: the AtomID in Database::atoms, USE_CONDITION: the FlagID
+
+    static auto tie_members(auto& self) { return std::tie(self.type, self.flag_state, self.end, self.payload); }
+};
+
+template <> struct SerializedEnum<DependencyNode::Type> { static constexpr auto last = DependencyNode::Type::USE_CONDITION; };
+
+/// \brief dependency tree of an ebuild, e.g. "a/b || ( c/d flag? ( e/f ) )", in a single node array
+/// \note  nodes[0] is an ALL_OF group, the root, unless there are no nodes at all. Nodes are
+///        stored in prefix order: the children of a group follow it, each one's subtree
+///        coming before the next child, so going from a child to the next is jumping to its 'end'
+/// \note  the atoms live in the AtomTable of the database, shared by every tree that names them
 struct Dependencies
 {
     bool valid = false;
-    std::vector<Dependencies> or_deps, xor_deps, at_most_one_deps, all_of_deps;
-    std::vector<PackageDependency> plain_deps;
-    std::vector<std::tuple<FlagID, bool, Dependencies>> use_cond_deps;
+    std::vector<DependencyNode> nodes;
+
+    bool empty() const { return nodes.empty(); }
+
+    /// \brief calls 'func(child_index)' for every child of the group at 'node_index', in order
+    template <class Func>
+    void for_each_child(std::size_t node_index, Func&& func) const
+    {
+        for(std::size_t child = node_index + 1 ; child < nodes[node_index].end ; child = nodes[child].end)
+            func(child);
+    }
+
+    static auto tie_members(auto& self)
+    {
+        return std::tie(self.valid, self.nodes);
+    }
+};
+
+/// \brief what identifies the content of an md5-cache entry, used to tell
+///        if an already parsed ebuild needs to be parsed again
+struct CacheEntryStamp
+{
+    std::int64_t mtime = 0;
+    std::uintmax_t size = 0;
+    std::string md5; // _md5_ var: checksum of the ebuild itself
+    std::size_t eclasses_hash = 0; // hash of the _eclasses_ var: inherited eclasses and their checksums
+
+    static auto tie_members(auto& self) { return std::tie(self.mtime, self.size, self.md5, self.eclasses_hash); }
+};
+
+/// \brief an md5-cache entry split into the variables an ebuild keeps, along with its stamp,
+///        prepared away from the ebuild, e.g. by the parser threads of Repo::load_ebuilds()
+struct CacheEntry
+{
+    RawVars vars;
+    CacheEntryStamp stamp;
+};
+
+using SlotID = std::uint32_t;
+
+/// \brief numbering of the slot and subslot names of the ebuilds of a package, e.g. "0" or "3.11",
+///        so that slots get compared as integers
+/// \note  owned by the package and shared by its ebuilds, like its LocalFlagIndex
+class SlotIndex
+{
+public:
+    /// \brief ID of 'name', which gets one if it has none yet
+    SlotID insert(std::string_view name)
+    {
+        SlotID id = find(name);
+        if(id != npos)
+            return id;
+
+        names.emplace_back(name);
+        return SlotID(names.size() - 1);
+    }
+
+    /// \brief ID of 'name', npos if none of the ebuilds has it
+    SlotID find(std::string_view name) const
+    {
+        // a package only has a handful of slots
+        for(SlotID id = 0 ; id < names.size() ; id++)
+            if(names[id] == name)
+                return id;
+        return npos;
+    }
+
+    const std::string& name(SlotID id) const { return names[id]; }
+    std::size_t size() const { return names.size(); }
+
+    static auto tie_members(auto& self) { return std::tie(self.names); }
+
+    constexpr static SlotID npos = std::numeric_limits<SlotID>::max();
+
+protected:
+    std::vector<std::string> names; // indexed by slot ID
+};
+
+/// \brief the fields of the ebuilds of a package that constraint matching and the resolver look
+///        at for every candidate, stored column by column, indexed by ebuild ID, rather than
+///        spread in the ebuilds among their paths, keywords, dependencies and flag sets
+/// \note  owned by the package and shared by its ebuilds, each one reads and writes its own entry
+struct EbuildColumns
+{
+    enum State : std::uint8_t {INSTALLED = 1, MASKED = 2, KEYWORD_ACCEPTED = 4};
+
+    std::vector<EbuildVersion> versions;
+    std::vector<SlotID> slot_ids, subslot_ids; // SlotIndex::npos when the ebuild has no SLOT
+    std::vector<std::uint8_t> states; // State bits
+
+    /// \return the ID of the new entry
+    std::size_t push_back(EbuildVersion version)
+    {
+        versions.push_back(std::move(version));
+        slot_ids.push_back(SlotIndex::npos);
+        subslot_ids.push_back(SlotIndex::npos);
+        states.push_back(0);
+        return versions.size() - 1;
+    }
+
+    /// \note the entries that come after 'id' move down by one
+    void erase(std::size_t id)
+    {
+        versions.erase(versions.begin() + id);
+        slot_ids.erase(slot_ids.begin() + id);
+        subslot_ids.erase(subslot_ids.begin() + id);
+        states.erase(states.begin() + id);
+    }
+
+    bool has(std::size_t id, State state) const { return states[id] & state; }
+
+    /// \brief same as Ebuild::respects_slot_constraint(), with the slot and subslot of the
+    ///        constraint already looked up in the slot index, npos standing for no constraint
+    bool respects_slot_ids(std::size_t id, SlotID constraint_slot_id, SlotID constraint_subslot_id) const
+    {
+        return (constraint_slot_id == SlotIndex::npos or constraint_slot_id == slot_ids[id]) and
+                (constraint_subslot_id == SlotIndex::npos or constraint_subslot_id == subslot_ids[id]);
+    }
+
+    void set(std::size_t id, State state, bool value)
+    {
+        if(value)
+            states[id] |= state;
+        else states[id] &= ~state;
+    }
+
+    static auto tie_members(auto& self) { return std::tie(self.versions, self.slot_ids, self.subslot_ids, self.states); }
 };
 
 class Database;
@@ -27,12 +176,37 @@ class Ebuild
 {
 public:
 
-    Ebuild(std::string ver,
-           Database *db);
+    /// \param columns: where the ebuild's entry 'id', with its version, already is
+    Ebuild(Database *db, EbuildColumns *columns, std::size_t id);
 
     void set_ebuild_path(std::filesystem::path path);
     void set_install_path(std::filesystem::path path);
 
+    /// \brief same, with the contents of the USE file of the entry already read,
+    ///        std::nullopt if it has none
+    void set_install_path(std::filesystem::path path, std::optional<std::string_view> use_file_contents);
+    void set_uninstalled();
+
+    /// \brief true if parsing the metadata would have to read the md5-cache entry first
+    bool needs_cache_entry() const { return not parsed_metadata and ebuild_data.empty() and not ebuild_path.empty(); }
+
+    /// \brief hands the contents of the md5-cache entry, e.g. read in bulk with read_files()
+    void set_cache_entry(std::string_view contents);
+    void set_cache_entry(CacheEntry entry);
+
+    /// \brief what set_cache_entry() does with the contents of the entry at 'entry_path',
+    ///        without any ebuild, so that it can be done on any thread
+    static CacheEntry read_cache_entry(const std::filesystem::path &entry_path, std::string_view contents);
+
+    const std::filesystem::path& get_ebuild_path() const { return ebuild_path; }
+    const std::filesystem::path& get_install_path() const { return install_path; }
+
+    bool cache_entry_changed();
+    void reload_metadata();
+    void reparse_deps();
+    void reset_flag_states();
+    bool has_complete_deps() const { return complete_deps; }
+
     bool operator <(const Ebuild &other);
     void parse_deps();
     void parse_metadata();
@@ -40,22 +214,36 @@ public:
     FlagState get_flag_state(const std::size_t &flag_id) ;
     bool has_changed_use();
     bool is_installed() const;
-    const std::unordered_set<FlagID>& get_iuse();
-    const std::unordered_set<FlagID>& get_use();
-    const std::unordered_set<FlagID>& get_use_mask();
-    const std::unordered_set<FlagID>& get_use_force();
 
-    std::unordered_set<FlagID> get_changed_flags();
-    std::unordered_set<FlagID> get_enforced_flags();
-    std::unordered_set<FlagID> get_active_flags();
-    std::unordered_set<FlagID> get_install_active_flags();
+    // flag sets are indexed by the local flag IDs of the package, see get_flag_index()
+    const DynamicBitset& get_iuse();
+    const DynamicBitset& get_iuse_effective();
+    const DynamicBitset& get_use();
+    const DynamicBitset& get_use_mask();
+    const DynamicBitset& get_use_force();
 
+    DynamicBitset get_changed_flags();
+    DynamicBitset get_enforced_flags();
+    const DynamicBitset& get_active_flags();
+    const DynamicBitset& get_install_active_flags();
+
+    void set_flag_index(LocalFlagIndex *index) { flag_index = index; }
+    const LocalFlagIndex& get_flag_index() const { return *flag_index; }
+
+    void set_slot_index(SlotIndex *index) { slot_index = index; }
+
+    // empty when the ebuild has no SLOT
     std::string get_slot_str() const;
     const std::string& get_slot() const;
     const std::string& get_subslot() const;
 
+    // IDs in the slot index of the package, SlotIndex::npos when the ebuild has no SLOT
+    SlotID get_slot_id() const { return columns->slot_ids[id]; }
+    SlotID get_subslot_id() const { return columns->subslot_ids[id]; }
+
     bool respects_pkg_dep(const PackageDependency &pkg_dep);
     bool respects_pkg_constraint(const PackageConstraint &pkg_constraint);
+    bool respects_slot_constraint(const SlotConstraint &slot_constraint);
     bool respects_usestates(const UseDependencies &use_dependencies);
 
     void accept_keywords(const Keywords& accept_these_keywords);
@@ -68,47 +256,65 @@ public:
     std::size_t get_id() const { return id; };
     std::size_t get_pkg_id() const { return pkg_id; };
     Keywords::State get_arch_keyword() const;
-    const EbuildVersion &get_version() const { return eversion; };
+    const EbuildVersion &get_version() const { return columns->versions[id]; };
+
+    bool is_keyword_accepted() const { return columns->has(id, EbuildColumns::KEYWORD_ACCEPTED); }
+    bool is_masked() const { return columns->has(id, EbuildColumns::MASKED); }
 
-    bool is_keyword_accepted() const { return keyword_accepted; }
+    const Dependencies& get_bdeps();
+    const Dependencies& get_rdeps();
+
+    void serialize(BinaryWriter &writer) const;
+    void deserialize(BinaryReader &reader);
+
+    /// \brief throws std::runtime_error if a flag set, a dependency tree or an ID is out of range
+    void check_ids() const;
 
     static const std::size_t npos = std::numeric_limits<std::size_t>::max();
 
 protected:
 
-    void load_install_time_active_flags();
+    void load_install_time_active_flags(std::string_view use_file_contents);
     void finalize_flag_states();
     void load_data();
+    void release_data();
 
     Dependencies parse_dep_string(std::string_view dep_string);
+    bool parse_dep_group(std::string_view dep_string, DependencyNode group, Dependencies &deps);
     void add_deps(Dependencies deps, DependencyType dep_type);
 
     void add_iuse_flag(FlagID flag_id, bool default_state);
     void add_iuse_flags(std::unordered_map<std::size_t, bool> useflags_and_default_states);
 
-    EbuildVersion eversion;
     Database* db;
+    EbuildColumns *columns; // owned by the package, shared by its ebuilds
 
     std::filesystem::path ebuild_path, install_path;
     Keywords keywords;
 
     Dependencies bdeps, rdeps;
-    std::unordered_map<std::string, std::string> ebuild_data;
+    RawVars ebuild_data; // the metadata variables, until both parse_metadata() and parse_deps() are done
+
+    CacheEntryStamp cache_stamp;
+
+    LocalFlagIndex *flag_index = nullptr; // owned by the package, shared by its ebuilds
+    SlotIndex *slot_index = nullptr; // same
 
-    std::unordered_set<FlagID> iuse, iuse_effective;
-    std::unordered_set<FlagID> use, use_mask, use_force;
+    DynamicBitset iuse, iuse_defaults, iuse_effective;
+    DynamicBitset use, use_mask, use_force;
+    DynamicBitset active_flags; // use + use_force - use_mask, once the flag states are finalized
 
-    std::unordered_set<FlagID> install_time_active_flags;
+    DynamicBitset install_time_active_flags;
 
     static const std::unordered_map<std::string, DependencyType> dependency_types;
     static const std::vector<std::string> metadata_vars;
+    static const std::vector<std::string> cache_stamp_vars;
 
     std::size_t id = npos, pkg_id = npos;
-    std::string slot, subslot;
 
-    bool masked = false, installed = false, changed_use = false;
+    bool changed_use = false;
     bool parsed_metadata = false, parsed_deps = false, finalized_flag_states = false;
-    bool keyword_accepted = false;
+    bool complete_deps = false; // every dependency string parsed and pointing to known packages
 };
 
 
@@ -1,11 +1,12 @@
 #ifndef EBUILD_VERSION_H
 #define EBUILD_VERSION_H
 
-#include <unordered_set>
+#include <array>
+#include <cstdint>
 #include <string>
-#include <regex>
-#include <utility>
-#include <vector>
+#include <string_view>
+
+#include "quantum-resolver/utils/serialization.h"
 
 struct VersionConstraint;
 
@@ -24,24 +25,34 @@ public:
     friend bool operator *= (const EbuildVersion &a, const EbuildVersion &b); // returns true if this matches with =1.23*
     friend bool operator ^= (const EbuildVersion &a, const EbuildVersion &b); // returns true if this ~ 1.23
 
-    bool respects_constraint(const VersionConstraint &constraint);
+    bool respects_constraint(const VersionConstraint &constraint) const;
+
+    /// \brief -1 if this comes before the versions that respect 'constraint', 0 if it respects it,
+    ///        1 if it comes after them
+    /// \note  the versions that respect a constraint are contiguous in the version order,
+    ///        so a sorted list of versions can be searched with it
+    int position_from(const VersionConstraint &constraint) const;
 
     const std::string &string() const;
-    bool is_live();
+    bool is_live() const;
+
+    void serialize(BinaryWriter &writer) const;
+    void deserialize(BinaryReader &reader);
 
 protected:
-    void update_live_bool(const std::vector<std::pair<std::size_t, std::string_view>>& split);
+    void append_key_token(unsigned char token_type, unsigned long number);
+    void append_key_token(unsigned char token_type, std::string_view digits);
+    void append_zero_component(std::string_view digits);
 
-    std::string version;
-    std::vector<std::pair<std::size_t, ulong>> version_parsing; // see operator <
-    bool live;
+    static int compare(const EbuildVersion &a, const EbuildVersion &b);
 
-    const static std::vector<std::string> ordered_separators;
-    const static std::regex ver_regexp;
-    const static std::pair<std::string, std::vector<std::string>> version_single_letter;
-    const static std::size_t dot_index;
-    const static std::unordered_set<std::size_t> smaller_than_nothing_separators;
+    std::string version;
 
+    // the version encoded so that comparing keys byte per byte gives the version order, see set_version()
+    std::array<unsigned char, 61> key {};
+    std::uint8_t key_size = 0;
+    std::uint8_t revisionless_key_size = 0; // the key without the revision nor the end marker, for ~ constraints
+    bool live;
 };
 
 struct VersionConstraint
@@ -50,8 +61,12 @@ struct VersionConstraint
 
     Type type = Type::NONE;
     EbuildVersion version;
+
+    static auto tie_members(auto& self) { return std::tie(self.type, self.version); }
 };
 
+template <> struct SerializedEnum<VersionConstraint::Type> { static constexpr auto last = VersionConstraint::Type::SGREATER; };
+
 
 
 #endif // EBUILD_VERSION_H
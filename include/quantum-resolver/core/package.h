@@ -5,7 +5,12 @@
 #include <filesystem>
 #include <deque>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
+#include "quantum-resolver/core/atom_table.h"
 #include "quantum-resolver/core/parser.h"
 #include "quantum-resolver/core/ebuild.h"
 
@@ -31,6 +36,13 @@ public:
     Ebuild& add_installed_version(const std::string& version,
                                   const std::filesystem::path &ebuild_install_path);
 
+    /// \brief same, with the contents of the USE file of the entry already read, see Ebuild::set_install_path()
+    Ebuild& add_installed_version(const std::string& version,
+                                  const std::filesystem::path &ebuild_install_path,
+                                  std::optional<std::string_view> use_file_contents);
+
+    void remove_version(const std::string &version);
+
     EbuildID ebuild_id_of(const std::string &version);
 
     void parse_metadata();
@@ -52,10 +64,42 @@ public:
 
     void accept_keywords(const PackageConstraint &constraint, const Keywords& accept_keywords);
 
+    /// \brief IDs of the ebuilds that match 'constraint', sorted by version
     std::vector<EbuildID> get_matching_ebuild_ids(const PackageConstraint &constraint);
 
+    /// \brief IDs of the ebuilds that match the version and slot constraint of 'constraint'
+    DynamicBitset match_ebuilds(const PackageConstraint &constraint);
+
+    /// \brief same as match_ebuilds() for the constraint of an interned atom of this package,
+    ///        computed once and kept until the ebuilds of the package change
+    /// \note  not thread-safe
+    const DynamicBitset& get_matching_ebuilds(AtomID atom_id);
+
+    /// \brief ebuild IDs from the lowest version to the highest one
+    const std::vector<EbuildID>& get_version_order();
+
+    /// \brief ebuild IDs grouped by slot, e.g. for the ebuilds that cannot be installed together,
+    ///        each group in version order, the ebuilds without a SLOT in the last group
+    const std::vector<std::vector<EbuildID>>& get_slot_groups();
+
+    const SlotIndex& get_slot_index() const { return *slot_index; }
+
+    /// \brief the versions, slots and states of the ebuilds, see EbuildColumns
+    const EbuildColumns& get_columns() const { return *columns; }
+
+    /// \brief forgets the cached matches, to call when an ebuild's version or slot may have changed
+    void forget_matching_ebuilds();
+
+    const LocalFlagIndex& get_flag_index() const { return *flag_index; }
+
     static constexpr EbuildID npos = NamedVector<Ebuild>::npos;
 
+    void serialize(BinaryWriter &writer) const;
+    void deserialize(BinaryReader &reader);
+
+    /// \brief throws std::runtime_error if an ID of the package or of its ebuilds is out of range
+    void check_ids() const;
+
     void set_id(std::size_t pkg_id);
     std::size_t get_id() const;
 
@@ -72,6 +116,16 @@ protected:
 
     Database *db;
     NamedVector<Ebuild> ebuilds; // indexed by ver, e.g. 11.1.0-r1
+
+    // on the heap so that the ebuilds can keep pointing to it when the package moves
+    std::shared_ptr<LocalFlagIndex> flag_index = std::make_shared<LocalFlagIndex>();
+    std::shared_ptr<SlotIndex> slot_index = std::make_shared<SlotIndex>();
+    std::shared_ptr<EbuildColumns> columns = std::make_shared<EbuildColumns>();
+
+    // none of them is serialized, they get filled again on demand
+    std::unordered_map<AtomID, DynamicBitset> matching_ebuilds_cache;
+    std::vector<EbuildID> version_order; // empty when it has to be sorted again
+    std::vector<std::vector<EbuildID>> slot_groups; // indexed by slot ID, empty when it has to be filled again
 };
 
 #endif // PACKAGE_H
@@ -13,6 +13,7 @@
 #include "quantum-resolver/core/ebuild_version.h"
 #include "quantum-resolver/utils/named_vector.h"
 #include "quantum-resolver/utils/string_utils.h"
+#include "quantum-resolver/utils/serialization.h"
 
 typedef std::size_t ExpandID;
 typedef std::size_t FlagID;
@@ -23,6 +24,11 @@ struct SlotConstraint
 {
     bool rebuild_on_slot_change = false, rebuild_on_subslot_change = false;
     std::string slot_str, subslot_str;
+
+    static auto tie_members(auto& self)
+    {
+        return std::tie(self.rebuild_on_slot_change, self.rebuild_on_subslot_change, self.slot_str, self.subslot_str);
+    }
 };
 
 struct DirectUseDependency
@@ -30,6 +36,8 @@ struct DirectUseDependency
     bool state = false;
     bool has_default_if_unexisting = false;
     bool default_if_unexisting = false;
+
+    static auto tie_members(auto& self) { return std::tie(self.state, self.has_default_if_unexisting, self.default_if_unexisting); }
 };
 
 struct ConditionalUseDependency
@@ -37,6 +45,8 @@ struct ConditionalUseDependency
     bool forward_if_set = false;
     bool forward_if_not_set = false;
     bool forward_reverse_state = false;
+
+    static auto tie_members(auto& self) { return std::tie(self.forward_if_set, self.forward_if_not_set, self.forward_reverse_state); }
 };
 
 struct UseflagDependency
@@ -48,13 +58,19 @@ struct UseflagDependency
 
     DirectUseDependency direct_dep;
     ConditionalUseDependency cond_dep;
+
+    static auto tie_members(auto& self) { return std::tie(self.type, self.flag_id, self.direct_dep, self.cond_dep); }
 };
 
+template <> struct SerializedEnum<UseflagDependency::Type> { static constexpr auto last = UseflagDependency::Type::CONDITIONAL; };
+
 struct PackageConstraint
 {
     std::size_t pkg_id = std::numeric_limits<size_t>::max();
     VersionConstraint ver;
     SlotConstraint slot;
+
+    static auto tie_members(auto& self) { return std::tie(self.pkg_id, self.ver, self.slot); }
 };
 
 using UseDependencies = std::vector<UseflagDependency>;
@@ -66,8 +82,12 @@ struct PackageDependency
     BlockerType blocker_type = BlockerType::NONE;
     PackageConstraint pkg_constraint;
     UseDependencies use_dependencies;
+
+    static auto tie_members(auto& self) { return std::tie(self.blocker_type, self.pkg_constraint, self.use_dependencies); }
 };
 
+template <> struct SerializedEnum<PackageDependency::BlockerType> { static constexpr auto last = PackageDependency::BlockerType::STRONG; };
+
 struct Toggle
 {
     size_t id = std::numeric_limits<size_t>::max();
@@ -88,6 +108,8 @@ struct Keywords
     std::unordered_map<ArchID, State> explicitely_defined;
     State everything_else = State::UNDEFINED;
 
+    static auto tie_members(auto& self) { return std::tie(self.explicitely_defined, self.everything_else); }
+
     State get_keyword(ArchID arch) const
     {
         auto it = explicitely_defined.find(arch);
@@ -107,6 +129,8 @@ struct Keywords
     }
 };
 
+template <> struct SerializedEnum<Keywords::State> { static constexpr auto last = Keywords::State::ACCEPT_EVERYTHING; };
+
 class Database;
 
 using UseflagStates = std::unordered_map<std::size_t, bool>;
@@ -128,6 +152,11 @@ public:
     PkgUseToggles parse_pkguse_line(std::string_view pkg_useflag_toggles);
     PkgAcceptkeywords parse_pkg_accept_keywords_line(std::string_view pkg_accept_keywords_line);
 
+    /// \brief package ID of a package.use* or package.accept_keywords line, the version,
+    ///        slot and settings are left unparsed, e.g. receives ">=app-misc/foo-1.2.3:0 -bar"
+    /// \return npos if the line names an unknown package, is empty or a comment
+    std::size_t parse_pkg_settings_pkg_id(std::string_view pkg_settings_line);
+
     PackageDependency parse_pkg_dependency(std::string_view pkg_constraint_str);
     UseDependencies parse_pkg_usedeps(std::string_view useflags_constraint_str);
     PackageConstraint parse_pkg_constraint(std::string_view pkg_constraint_str);
@@ -8,15 +8,50 @@
 #include <limits>
 #include <string>
 #include <string_view>
+#include <map>
+#include <vector>
+#include <cstdint>
 
 #include "quantum-resolver/core/package.h"
 #include "quantum-resolver/core/parser.h"
 #include "quantum-resolver/core/useflags.h"
 #include "quantum-resolver/utils/string_utils.h"
+#include "quantum-resolver/utils/file_utils.h"
 
 class Database;
 
 using PackageID = std::size_t;
+using GlobalEbuildID = std::size_t;
+
+/// \brief a line of a package.use* or package.accept_keywords file, kept so that
+///        a refresh can tell which packages got their settings changed
+struct PackageSettingsLine
+{
+    enum struct Type {USEFLAGS, ACCEPT_KEYWORDS};
+
+    Type type;
+    FlagAssignType assign_type = FlagAssignType::DIRECT;
+    std::string line;
+    PackageID pkg_id; // npos if the line names an unknown package
+
+    bool operator ==(const PackageSettingsLine &other) const = default;
+
+    static auto tie_members(auto& self) { return std::tie(self.type, self.assign_type, self.line, self.pkg_id); }
+};
+
+template <> struct SerializedEnum<PackageSettingsLine::Type> { static constexpr auto last = PackageSettingsLine::Type::ACCEPT_KEYWORDS; };
+
+/// \brief a per package setting line once parsed, ready to be applied to the ebuilds of its package
+struct PackageSetting
+{
+    PackageSettingsLine::Type type;
+    FlagAssignType assign_type;
+    PackageConstraint pkg_constraint;
+    UseflagStates use_toggles;
+    Keywords accept_keywords;
+
+    static auto tie_members(auto& self) { return std::tie(self.type, self.assign_type, self.pkg_constraint, self.use_toggles, self.accept_keywords); }
+};
 
 class Repo
 {
@@ -26,29 +61,124 @@ public:
     bool is_system_pkg(PackageID pkg_id) const;
     bool is_selected_pkg(PackageID pkg_id) const;
 
+    const std::unordered_set<PackageID>& get_system_pkgs() const { return system_pkgs; }
+    const std::unordered_set<PackageID>& get_selected_pkgs() const { return selected_pkgs; }
+    std::size_t size() const { return pkgs.size(); }
+
     std::size_t get_pkg_id(const std::string_view &pkg_str) const;
     const std::string& get_pkg_groupname(std::size_t pkg_id) const;
 
-    Package& operator [] (PackageID pkg_id) { return pkgs[pkg_id]; };
+    /// \note after load_lazily(), the package gets loaded the first time it is asked for
+    Package& operator [] (PackageID pkg_id)
+    {
+        if(pkg_id < unloaded_pkgs.size() and unloaded_pkgs[pkg_id])
+            load_package(pkg_id);
+        return pkgs[pkg_id];
+    };
+
+    /// \brief number of ebuilds in the repository, global ebuild IDs go from 0 to it
+    std::size_t ebuilds_count() const { return ebuild_pkg_ids.size(); }
+
+    /// \brief number of an ebuild across the whole repository, e.g. to index flat per ebuild arrays
+    /// \note  the ebuilds of a package have consecutive global IDs, packages come in ID order.
+    ///        The numbering is done again by load() and refresh() since ebuilds come and go
+    GlobalEbuildID global_ebuild_id(PackageID pkg_id, EbuildID ebuild_id) const { return pkg_offsets[pkg_id] + ebuild_id; }
+
+    /// \brief package ID and ebuild ID of a global ebuild ID
+    std::pair<PackageID, EbuildID> ebuild_of(GlobalEbuildID id) const
+    {
+        PackageID pkg_id = ebuild_pkg_ids[id];
+        return {pkg_id, id - pkg_offsets[pkg_id]};
+    }
+
+    void load();
+
+    /// \brief only indexes the package names and versions from the md5-cache and /var/db/pkg
+    ///        folder listings, and which per package settings lines target which package.
+    ///        A package is read, parsed and gets its settings applied the first time
+    ///        operator[] hands it out
+    /// \note  a package loaded later can get installed-only versions, which moves the global
+    ///        ebuild IDs: meant for single package queries, not for the resolver
+    void load_lazily();
+
+    /// \brief updates what changed on disk since load(), or since the snapshot has been written:
+    ///        md5-cache entries, installed packages, per package settings and the world file
+    /// \return true if anything changed
+    /// \note  package IDs are kept, new packages get appended
+    bool refresh();
+
+    /// \brief applies what changed in a single /var/db/pkg entry, e.g. "sys-devel", "gcc-12.2.1":
+    ///        it got installed, uninstalled, or its USE file got rewritten
+    /// \return true if anything changed
+    /// \note  only the package of the entry is looked at, nothing else is read again
+    bool refresh_installed_entry(const std::string &category, const std::string &pkg_namever);
+
+    void parse_ebuild_metadata();
+    void parse_deps();
+
+    void serialize(BinaryWriter &writer) const;
+
+    /// \note throws std::runtime_error if a package ID read is out of range, the atoms are
+    ///       checked by the database once the packages are known
+    void deserialize(BinaryReader &reader);
 
     constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
 
+    inline static const std::filesystem::path md5_cache_path = rooted_path("/var/db/repos/gentoo/metadata/md5-cache");
+    inline static const std::filesystem::path installed_pkgs_path = rooted_path("/var/db/pkg");
+    inline static const std::filesystem::path selected_pkgs_path = rooted_path("/var/lib/portage/world");
+
 protected:
-    void load_ebuilds(const std::string &path);
+    /// \brief lists the md5-cache, and reads every entry if 'read_cache_entries'
+    void load_ebuilds(const std::filesystem::path &cache_path, bool read_cache_entries);
+    std::vector<NamedVector<Package>> load_categories_with_cache_entries(const std::vector<std::filesystem::path> &category_paths);
+    NamedVector<Package> load_category_ebuilds(const std::filesystem::path &category_path);
     void load_installed_pkgs();
+    void load_installed_category(const std::filesystem::path &category_path);
+    void load_installed_categories(const std::vector<std::filesystem::path> &category_paths);
+    void load_ebuild_cache_entries();
+    void load_package(PackageID pkg_id);
 
-    void parse_ebuild_metadata();
-    void parse_deps();
-
-    void load_package_accept_keywords();
-    void load_package_useflag_settings();
+    std::vector<PackageSettingsLine> read_package_settings_lines();
+    void load_package_settings();
+    void index_package_settings();
+    void apply_package_settings(PackageID pkg_id);
 
     void load_system_packages();
     void load_selected_packages();
 
+    std::vector<PackageID> get_category_pkg_ids(const std::string &category) const;
+
+    void refresh_ebuilds(std::unordered_set<PackageID> &touched_pkgs);
+    void refresh_installed_pkgs(std::unordered_set<PackageID> &touched_pkgs);
+    void refresh_package_settings(std::unordered_set<PackageID> &touched_pkgs);
+    bool refresh_package_sets();
+
+    void number_ebuilds();
+    void check_ids() const;
+
     NamedVector<Package> pkgs;
     std::unordered_set<PackageID> selected_pkgs, system_pkgs;
 
+    // not serialized, see number_ebuilds()
+    std::vector<GlobalEbuildID> pkg_offsets; // global ID of the first ebuild of each package
+    std::vector<PackageID> ebuild_pkg_ids; // indexed by global ID
+
+    std::vector<PackageSettingsLine> pkg_settings_lines; // in the order they are applied
+    std::vector<PackageSetting> parsed_pkg_settings; // parsed pkg_settings_lines, same indices
+
+    // not serialized, see index_package_settings(): indexed by package ID,
+    // the indices in pkg_settings_lines of the settings of the package, in order
+    std::vector<std::vector<std::size_t>> pkg_settings;
+
+    // only used by load_lazily(): what load_package() has left to do
+    bool lazy = false;
+    std::vector<bool> unloaded_pkgs;
+    std::unordered_map<PackageID, std::vector<std::pair<std::string, std::filesystem::path>>> unloaded_installed_versions;
+    std::map<std::string, std::int64_t> cache_category_mtimes, installed_category_mtimes;
+
+    static const std::vector<std::pair<std::string, FlagAssignType>> pkguse_profile_files;
+
     Database *db;
 
 };
@@ -5,19 +5,23 @@
 #include "quantum-resolver/core/parser.h"
 
 #include "quantum-resolver/utils/named_vector.h"
-#include "quantum-resolver/utils/bijection.h"
+#include "quantum-resolver/utils/concurrent_interner.h"
 #include "quantum-resolver/utils/multikey_map.h"
 #include "quantum-resolver/utils/string_utils.h"
 #include "quantum-resolver/utils/concepts.h"
+#include "quantum-resolver/utils/dynamic_bitset.h"
 
+#include <cstdint>
 #include <unordered_set>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string_view>
 #include <limits>
 #include <ranges>
 #include <map>
+#include <vector>
 
 using ExpandID = std::size_t;
 using FlagID = std::size_t;
@@ -25,6 +29,8 @@ using FlagName = std::string;
 
 enum struct FlagAssignType {DIRECT, STABLE_DIRECT, MASK, STABLE_MASK, FORCE, STABLE_FORCE};
 
+template <> struct SerializedEnum<FlagAssignType> { static constexpr auto last = FlagAssignType::STABLE_FORCE; };
+
 class Database;
 
 enum struct FlagState {ON, OFF, FORCED, MASKED, NOT_IN_IUSE_EFFECTIVE};
@@ -45,6 +51,8 @@ struct UseExpandName
         return name == other.name;
     }
 
+    static auto tie_members(auto& self) { return std::tie(self.name); }
+
     std::string name;
 };
 
@@ -62,8 +70,49 @@ namespace std {
 struct UseExpandType
 {
     bool unprefixed = false, implicit = false, hidden = false;
+
+    static auto tie_members(auto& self) { return std::tie(self.unprefixed, self.implicit, self.hidden); }
+};
+
+/// \brief numbers from 0 the flags that the ebuilds of a package refer to, so that their
+///        flag sets are DynamicBitsets of a few words rather than sets of global FlagIDs
+/// \note  local IDs never change once given, the index only grows
+class LocalFlagIndex
+{
+public:
+    using LocalFlagID = std::size_t;
+
+    /// \brief local ID of 'flag_id', which gets one if it has none yet
+    LocalFlagID insert(FlagID flag_id);
+
+    /// \brief local ID of 'flag_id', npos if none of the ebuilds refers to it
+    LocalFlagID find(FlagID flag_id) const;
+
+    FlagID flag_id(LocalFlagID local_id) const { return flag_ids[local_id]; }
+    std::size_t size() const { return flag_ids.size(); }
+
+    /// \brief the flags of 'local_flags' that are in 'flags', a set of global FlagIDs
+    DynamicBitset select(const DynamicBitset &local_flags, const DynamicBitset &flags) const;
+
+    std::vector<FlagID> to_flag_ids(const DynamicBitset &local_flags) const;
+
+    static auto tie_members(auto& self) { return std::tie(self.flag_ids, self.sorted_local_ids); }
+
+    /// \brief throws std::runtime_error if a flag is not below 'flags_count', or if the local IDs
+    ///        are not a permutation ordered by flag
+    void check_ids(std::size_t flags_count) const;
+
+    constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+protected:
+    std::vector<FlagID> flag_ids; // indexed by local ID
+    std::vector<std::uint32_t> sorted_local_ids; // ordered by global flag ID, for binary searches
 };
 
+/// \brief global flag states from the profiles, and the numbering of every flag name
+/// \note  add_flag(), get_flag_id() and get_flag_name() can be called from several threads
+///        at once, e.g. by the parallel parsing of the ebuilds, the rest is only modified
+///        while the profiles get loaded
 class UseFlags
 {
 public:
@@ -73,6 +122,7 @@ public:
     FlagID add_flag(const std::string_view &flag_str);
     FlagID get_flag_id(const std::string_view &flag_str) const;
     const FlagName& get_flag_name(const std::size_t &id) const;
+    std::size_t flags_count() const { return useflags.size(); }
 
     template <IntegerRange Range>
     std::map<std::string, FlagID> to_flag_names(const Range& flag_ids) const
@@ -113,26 +163,33 @@ public:
 
     const Keywords& get_accepted_keywords() const { return accepted_keywords; }
 
-    const std::unordered_set<FlagID>& get_implicit_flags() const;
-    const std::unordered_set<FlagID>& get_hidden_flags() const;
-    const std::unordered_set<FlagID>& get_expand_flags() const;
+    const DynamicBitset& get_implicit_flags() const;
+    const DynamicBitset& get_hidden_flags() const;
+    const DynamicBitset& get_expand_flags() const;
 
-    const std::unordered_set<FlagID>& get_use() const;
+    const DynamicBitset& get_use() const;
 
-    const std::unordered_set<FlagID>& get_use_force() const;
-    const std::unordered_set<FlagID>& get_use_stable_force() const;
+    const DynamicBitset& get_use_force() const;
+    const DynamicBitset& get_use_stable_force() const;
 
-    const std::unordered_set<FlagID>& get_use_mask() const;
-    const std::unordered_set<FlagID>& get_use_stable_mask() const;
+    const DynamicBitset& get_use_mask() const;
+    const DynamicBitset& get_use_stable_mask() const;
+
+    void populate_profile_flags();
+
+    void serialize(BinaryWriter &writer) const;
+    void deserialize(BinaryReader &reader);
+
+    /// \brief throws std::runtime_error if a flag set or the arch names a flag that does not exist
+    void check_ids() const;
 
     constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
 
 protected:
-    void populate_profile_flags();
 
     void set_arch();
 
-    void handle_use_line(std::string_view flags, std::unordered_set<FlagID> &container);
+    void handle_use_line(std::string_view flags, DynamicBitset &container);
     void handle_iuse_implicit_line(std::string_view flags);
     void handle_use_expand_line(std::string_view use_expand_type, std::string_view words);
 
@@ -143,13 +200,16 @@ protected:
     MultiKeyMap<UseExpandType, UseExpandName, FlagName, FlagID> use_expand;
     // use_expand characterization, reachable with the prefix string, and with the flag ids connected to the prefix
 
-    Bijection<std::string, FlagID> useflags;
+    ConcurrentInterner useflags;
     // all the encountered useflags
 
-    std::unordered_set<FlagID> implicit_useflags, hidden_useflags, expand_useflags;
+    std::unique_ptr<std::mutex> new_flags_mutex = std::make_unique<std::mutex>();
+    // guards the use expand keys and expand_useflags that add_flag() fills for new flags
+
+    DynamicBitset implicit_useflags, hidden_useflags, expand_useflags;
     // all the implicit flags
 
-    std::unordered_set<FlagID> use, use_mask, use_force, use_stable_force, use_stable_mask;
+    DynamicBitset use, use_mask, use_force, use_stable_force, use_stable_mask;
     // ids of the globally set useflags
 
     std::size_t current_arch = npos;
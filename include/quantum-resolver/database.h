@@ -2,19 +2,58 @@
 #define DATABASE_H
 
 #include <memory>
+#include <filesystem>
 
+#include "quantum-resolver/core/atom_table.h"
 #include "quantum-resolver/core/repo.h"
 #include "quantum-resolver/core/parser.h"
 #include "quantum-resolver/core/useflags.h"
+#include "quantum-resolver/utils/thread_utils.h"
 
 class Database
 {
 public:
-    Database();
+    enum struct LoadMode
+    {
+        /// start from the binary snapshot written by a previous run and refresh it with what
+        /// changed on disk since, a new snapshot is written whenever it had to be refreshed
+        /// or rebuilt from text
+        SNAPSHOT,
+        /// parse the text files, without any snapshot
+        FULL,
+        /// only index the package names, see Repo::load_lazily(), e.g. for single package queries
+        LAZY,
+    };
+
+    Database(LoadMode mode = LoadMode::SNAPSHOT);
+
+    /// \brief the threads everything runs in parallel on, QUANTUM_JOBS of them if set
+    /// \note  first, so that it outlives what it runs for
+    Executor executor;
 
     Parser parser;
     UseFlags useflags;
+    AtomTable atoms;
     Repo repo;
+
+    /// \brief where the snapshot lives, can be overridden with the QUANTUM_SNAPSHOT environment variable
+    static std::filesystem::path snapshot_path();
+
+    /// \brief brings the database up to date with the files on disk, only re-parsing
+    ///        what changed when the profiles (besides their package.* files) did not
+    /// \return true if anything changed
+    bool refresh();
+
+protected:
+    void load();
+    bool load_snapshot();
+    void save_snapshot();
+
+    static std::uint64_t profiles_fingerprint();
+    std::uint64_t loaded_profiles_fingerprint = 0;
+
+    constexpr static std::uint32_t snapshot_format_version = 14;
+    constexpr static std::string_view snapshot_magic = "quantum-resolver snapshot";
 };
 
 #endif // DATABASE_H
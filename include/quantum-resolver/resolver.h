@@ -1,14 +1,87 @@
 #ifndef RESOLVER_H
 #define RESOLVER_H
 
+#include <deque>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
 
+#include "quantum-resolver/core/package.h"
+#include "quantum-resolver/core/repo.h"
+#include "quantum-resolver/utils/sat_solver.h"
+
+class Database;
+
+struct ResolvedEbuild
+{
+    PackageID pkg_id;
+    EbuildID ebuild_id;
+    DynamicBitset active_flags; // local flag IDs of the package
+    bool up_to_date = false; // installed with the same active flags, nothing to do
+};
+
+struct Resolution
+{
+    bool solved = false;
+    std::vector<ResolvedEbuild> ebuilds; // every ebuild of the solution, by package ID then ebuild ID
+
+    std::size_t vars_count = 0, clauses_count = 0;
+    SatSolver::Stats solver_stats;
+};
+
+/// \brief dependency resolution as a boolean satisfiability problem
+/// \note  variables: one per ebuild of every package that can be reached from the
+///        requested atoms, one per (ebuild, useflag) that a dependency looks at,
+///        plus auxiliary ones for alternatives and conditions
+/// \note  clauses: at most one ebuild per (package, slot), masked or non keyworded
+///        ebuilds are excluded unless installed, an ebuild implies its run time
+///        dependencies, and its build time ones if it isn't installed yet,
+///        blockers exclude the ebuilds they match, forced and masked flags are fixed
+/// \note  the solver decides the highest visible versions last and keeps installed
+///        ebuilds selected unless something conflicts with them
 class Resolver
 {
 public:
-    Resolver();
+    Resolver(Database *db);
+
+    /// \brief finds a set of ebuilds that satisfies 'atoms' and the dependencies of every ebuild in it
+    /// \param allow_use_changes: let the solver flip the flags that are neither forced nor masked,
+    ///        otherwise every flag keeps its configured state
+    Resolution resolve(const std::vector<PackageDependency> &atoms, bool allow_use_changes = false);
 
 protected:
+    using Lit = SatSolver::Lit;
+
+    void encode_package(PackageID pkg_id);
+    void encode_ebuild(PackageID pkg_id, EbuildID ebuild_id);
+
+    void encode_deps(const Dependencies &deps, std::size_t node_index, Lit condition, PackageID pkg_id, EbuildID ebuild_id);
+
+    enum struct ChoiceType {AT_LEAST_ONE, EXACTLY_ONE, AT_MOST_ONE};
+    void encode_choice(const Dependencies &deps, std::size_t node_index, Lit condition, ChoiceType type, PackageID pkg_id, EbuildID ebuild_id);
+
+    void encode_pkg_dep(const PackageDependency &pkg_dep, AtomID atom_id, Lit condition, PackageID pkg_id, EbuildID ebuild_id);
+
+    Lit ebuild_lit(PackageID pkg_id, EbuildID ebuild_id);
+    Lit flag_lit(PackageID pkg_id, EbuildID ebuild_id, FlagID flag_id, bool state);
+    Lit usedep_lit(PackageID pkg_id, EbuildID ebuild_id, const UseflagDependency &use_dep, bool state);
+    Lit and_lit(Lit condition, Lit lit);
+    Lit new_aux_lit(double activity = 0);
+
+    std::vector<ResolvedEbuild> read_solution();
+
+    Database *db;
+
+    SatSolver solver;
+    Lit true_lit, false_lit;
+    bool allow_use_changes = false;
+
+    std::vector<SatSolver::Var> ebuild_vars; // indexed by global ebuild ID, no_var until its package gets encoded
+    std::map<std::pair<GlobalEbuildID, FlagID>, SatSolver::Var> flag_vars;
 
+    constexpr static SatSolver::Var no_var = std::numeric_limits<SatSolver::Var>::max();
+    std::deque<std::pair<PackageID, EbuildID>> ebuilds_to_encode;
 };
 
 #endif // RESOLVER_H
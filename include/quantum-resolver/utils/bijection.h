@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <iterator>
 #include <type_traits>
 #include <utility>
@@ -7,6 +8,7 @@
 #include <unordered_map>
 
 #include "quantum-resolver/utils/concepts.h"
+#include "quantum-resolver/utils/serialization.h"
 
 template <class Husband, class Wife> requires (! std::is_same_v<Husband, Wife>)
 class Bijection
@@ -57,6 +59,26 @@ public:
 
     std::size_t size() const { return couples.size(); }
 
+    void serialize(BinaryWriter &writer) const
+    {
+        // same encoding as a vector of couples
+        writer.write(std::uint64_t(couples.size()));
+        for(const auto& couple: couples)
+            writer.write(couple);
+    }
+
+    void deserialize(BinaryReader &reader)
+    {
+        std::vector<std::pair<Husband, Wife>> saved_couples;
+        reader.read(saved_couples);
+
+        couples.clear();
+        husband_index.clear();
+        wife_index.clear();
+        for(auto& [h, w]: saved_couples)
+            add_couple(std::move(h), std::move(w));
+    }
+
 protected:
     template <class Member> requires (is_any_of<Member, Wife, Husband>)
     auto& get_map() const
@@ -66,7 +88,8 @@ protected:
         else return wife_index;
     }
 
-    std::vector<std::pair<Husband, Wife>> couples;
+    // a deque so that references to the couples stay valid when new ones get added
+    std::deque<std::pair<Husband, Wife>> couples;
     std::unordered_map<Husband, size_t> husband_index;
     std::unordered_map<Wife, size_t> wife_index;
 };
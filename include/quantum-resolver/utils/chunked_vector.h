@@ -0,0 +1,102 @@
+#ifndef CHUNKED_VECTOR_H
+#define CHUNKED_VECTOR_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+template <class T>
+class ChunkedVector
+{
+    // A vector whose elements never move: it grows by adding chunks rather than by reallocating,
+    // chunk k holds first_chunk_size << k elements. References to elements stay valid until
+    // destruction, and growing it does not disturb the threads that read other elements.
+    // Only the chunk allocation is synchronized: writing a given element is up to the caller.
+
+public:
+    ChunkedVector() {}
+
+    ChunkedVector(const ChunkedVector&) = delete;
+    ChunkedVector& operator = (const ChunkedVector&) = delete;
+
+    ChunkedVector(ChunkedVector&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    ChunkedVector& operator = (ChunkedVector&& other) noexcept
+    {
+        // not meant to happen while other threads use either vector
+        if(this != &other)
+        {
+            clear();
+            for(std::size_t k = 0 ; k < max_chunks ; k++)
+                chunks[k].store(other.chunks[k].exchange(nullptr));
+        }
+        return *this;
+    }
+
+    ~ChunkedVector() { clear(); }
+
+    /// \brief the element at 'index', its chunk has to exist, see ensure()
+    T& operator [](std::size_t index)
+    {
+        auto [chunk, offset] = locate(index);
+        return chunks[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    const T& operator [](std::size_t index) const
+    {
+        auto [chunk, offset] = locate(index);
+        return chunks[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    /// \brief the element at 'index', after allocating its chunk if it doesn't exist yet
+    T& ensure(std::size_t index)
+    {
+        auto [chunk, offset] = locate(index);
+        T* chunk_data = chunks[chunk].load(std::memory_order_acquire);
+        if(chunk_data == nullptr)
+        {
+            std::scoped_lock lock(allocation_mutex);
+            chunk_data = chunks[chunk].load(std::memory_order_acquire);
+            if(chunk_data == nullptr)
+            {
+                chunk_data = new T[first_chunk_size << chunk]();
+                chunks[chunk].store(chunk_data, std::memory_order_release);
+            }
+        }
+        return chunk_data[offset];
+    }
+
+    /// \brief destroys every element, not thread-safe
+    void clear()
+    {
+        for(auto& chunk: chunks)
+            delete[] chunk.exchange(nullptr);
+    }
+
+protected:
+    static std::pair<std::size_t, std::size_t> locate(std::size_t index)
+    {
+        // chunk k starts at first_chunk_size * (2^k - 1)
+        const std::size_t chunk = std::bit_width(index / first_chunk_size + 1) - 1;
+        if(chunk >= max_chunks)
+            throw std::out_of_range("ChunkedVector index too big");
+
+        return {chunk, index - first_chunk_size * ((std::size_t(1) << chunk) - 1)};
+    }
+
+    constexpr static std::size_t first_chunk_size = 64;
+    constexpr static std::size_t max_chunks = 40;
+
+    std::array<std::atomic<T*>, max_chunks> chunks {};
+    std::mutex allocation_mutex;
+};
+
+#endif // CHUNKED_VECTOR_H
@@ -0,0 +1,149 @@
+#ifndef CONCURRENT_INTERNER_H
+#define CONCURRENT_INTERNER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "quantum-resolver/utils/chunked_vector.h"
+#include "quantum-resolver/utils/serialization.h"
+
+class ConcurrentInterner
+{
+    // Gives dense IDs, 0, 1, 2..., to strings, and can be used from several threads at once.
+    // The lookup table is split in shards, picked from the hash of the string, that each have
+    // their own lock: threads only wait for each other when they touch the same shard, and
+    // only for the (rare) insertion of a new string since lookups take the lock shared.
+    // The strings live in a ChunkedVector, indexed by ID, so the string_view keys of the
+    // shards and the references given by name() stay valid while new strings get added.
+    // IDs given while several threads insert depend on which thread comes first.
+
+public:
+    using ID = std::size_t;
+
+    ConcurrentInterner() {}
+
+    ConcurrentInterner(ConcurrentInterner&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    ConcurrentInterner& operator = (ConcurrentInterner&& other) noexcept
+    {
+        // not meant to happen while other threads use either interner
+        if(this != &other)
+        {
+            for(std::size_t i = 0 ; i < shards_count ; i++)
+                shards[i].ids = std::move(other.shards[i].ids);
+            names = std::move(other.names);
+            count.store(other.count.exchange(0));
+        }
+        return *this;
+    }
+
+    /// \brief ID of 'str', which gets the next free ID if it has none yet
+    /// \return the ID and true if 'str' has just been added
+    std::pair<ID, bool> insert(std::string_view str)
+    {
+        return insert(str, [](ID){});
+    }
+
+    /// \brief same as insert(str), 'on_insert(id)' is called when 'str' gets added, before
+    ///        any other thread can find it: e.g. to fill a table of values indexed by ID
+    template <class OnInsert>
+    std::pair<ID, bool> insert(std::string_view str, OnInsert&& on_insert)
+    {
+        Shard& shard = shard_of(str);
+
+        {
+            std::shared_lock lock(shard.mutex);
+            if(auto it = shard.ids.find(str); it != shard.ids.end())
+                return {it->second, false};
+        }
+
+        std::unique_lock lock(shard.mutex);
+        if(auto it = shard.ids.find(str); it != shard.ids.end())
+            return {it->second, false};
+
+        const ID id = count.fetch_add(1);
+        std::string& name = names.ensure(id);
+        name = str;
+        on_insert(id);
+        shard.ids.emplace(std::string_view(name), id);
+
+        return {id, true};
+    }
+
+    /// \brief ID of 'str', npos if it has none
+    ID find(std::string_view str) const
+    {
+        const Shard& shard = shard_of(str);
+
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.ids.find(str);
+        return it == shard.ids.end() ? npos : it->second;
+    }
+
+    /// \brief the string of 'id', which has to have been given by insert() or find()
+    const std::string& name(ID id) const { return names[id]; }
+
+    bool contains(ID id) const { return id < count.load(); }
+
+    /// \brief number of IDs given so far
+    std::size_t size() const { return count.load(); }
+
+    void serialize(BinaryWriter &writer) const
+    {
+        writer.write(std::uint64_t(size()));
+        for(ID id = 0 ; id < size() ; id++)
+            writer.write(names[id]);
+    }
+
+    void deserialize(BinaryReader &reader)
+    {
+        for(Shard& shard: shards)
+            shard.ids.clear();
+        names.clear();
+        count = 0;
+
+        const std::size_t names_count = reader.read<std::uint64_t>();
+        for(std::size_t id = 0 ; id < names_count ; id++)
+            insert(reader.read<std::string>());
+    }
+
+    constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+protected:
+    constexpr static std::size_t shards_count = 64;
+
+    struct Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string_view, ID> ids; // the views point to 'names'
+    };
+
+    Shard& shard_of(std::string_view str)
+    {
+        return shards[std::hash<std::string_view>{}(str) % shards_count];
+    }
+
+    const Shard& shard_of(std::string_view str) const
+    {
+        return shards[std::hash<std::string_view>{}(str) % shards_count];
+    }
+
+    std::array<Shard, shards_count> shards;
+    ChunkedVector<std::string> names; // indexed by ID
+    std::atomic<std::size_t> count = 0;
+};
+
+#endif // CONCURRENT_INTERNER_H
@@ -0,0 +1,195 @@
+#ifndef DYNAMIC_BITSET_H
+#define DYNAMIC_BITSET_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "quantum-resolver/utils/serialization.h"
+
+class DynamicBitset
+{
+    // A set of small integers, stored as one bit per integer, that grows as needed.
+    // Set operations work on whole machine words, with the same operators as the ones
+    // of misc_utils.h for unordered sets: + union, - difference, & intersection, ^ symmetric difference
+    // The last word is never zero, so that equal sets have equal words
+
+public:
+    class const_iterator
+    {
+        // Iterates over the integers in the set, in increasing order
+
+    public:
+        using value_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        const_iterator() {}
+        const_iterator(const std::vector<std::uint64_t> *words, std::size_t word_index) : words(words), word_index(word_index)
+        {
+            if(word_index < words->size())
+                remaining = (*words)[word_index];
+            skip_empty_words();
+        }
+
+        std::size_t operator *() const { return word_index * 64 + std::countr_zero(remaining); }
+
+        const_iterator& operator ++()
+        {
+            remaining &= remaining - 1; // clear the lowest set bit
+            skip_empty_words();
+            return *this;
+        }
+
+        const_iterator operator ++(int)
+        {
+            const_iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator ==(const const_iterator& other) const
+        {
+            return word_index == other.word_index and remaining == other.remaining;
+        }
+
+    protected:
+        void skip_empty_words()
+        {
+            while(remaining == 0 and word_index < words->size())
+                if(++word_index < words->size())
+                    remaining = (*words)[word_index];
+        }
+
+        const std::vector<std::uint64_t> *words = nullptr;
+        std::size_t word_index = 0;
+        std::uint64_t remaining = 0;
+    };
+
+    DynamicBitset() {}
+
+    const_iterator begin() const { return const_iterator(&words, 0); }
+    const_iterator end() const { return const_iterator(&words, words.size()); }
+
+    bool contains(std::size_t value) const
+    {
+        return value / 64 < words.size() and (words[value / 64] >> (value % 64)) & 1;
+    }
+
+    void insert(std::size_t value)
+    {
+        if(value / 64 >= words.size())
+            words.resize(value / 64 + 1, 0);
+        words[value / 64] |= std::uint64_t(1) << (value % 64);
+    }
+
+    void erase(std::size_t value)
+    {
+        // values that are not in the set, npos included, are fine
+        if(value / 64 >= words.size())
+            return;
+        words[value / 64] &= ~(std::uint64_t(1) << (value % 64));
+        trim();
+    }
+
+    std::size_t size() const
+    {
+        std::size_t count = 0;
+        for(std::uint64_t word: words)
+            count += std::popcount(word);
+        return count;
+    }
+
+    /// \brief every value in the set is below it
+    std::size_t bound() const { return words.empty() ? 0 : words.size() * 64 - std::countl_zero(words.back()); }
+
+    bool empty() const { return words.empty(); }
+    void clear() { words.clear(); }
+
+    bool operator ==(const DynamicBitset& other) const = default;
+
+    bool intersects(const DynamicBitset& other) const
+    {
+        for(std::size_t i = 0 ; i < std::min(words.size(), other.words.size()) ; i++)
+            if(words[i] & other.words[i])
+                return true;
+        return false;
+    }
+
+    bool is_subset_of(const DynamicBitset& other) const
+    {
+        if(words.size() > other.words.size())
+            return false;
+        for(std::size_t i = 0 ; i < words.size() ; i++)
+            if(words[i] & ~other.words[i])
+                return false;
+        return true;
+    }
+
+    DynamicBitset& operator +=(const DynamicBitset& other)
+    {
+        if(other.words.size() > words.size())
+            words.resize(other.words.size(), 0);
+        for(std::size_t i = 0 ; i < other.words.size() ; i++)
+            words[i] |= other.words[i];
+        return *this;
+    }
+
+    DynamicBitset& operator -=(const DynamicBitset& other)
+    {
+        for(std::size_t i = 0 ; i < std::min(words.size(), other.words.size()) ; i++)
+            words[i] &= ~other.words[i];
+        trim();
+        return *this;
+    }
+
+    DynamicBitset& operator &=(const DynamicBitset& other)
+    {
+        if(words.size() > other.words.size())
+            words.resize(other.words.size());
+        for(std::size_t i = 0 ; i < words.size() ; i++)
+            words[i] &= other.words[i];
+        trim();
+        return *this;
+    }
+
+    DynamicBitset& operator ^=(const DynamicBitset& other)
+    {
+        if(other.words.size() > words.size())
+            words.resize(other.words.size(), 0);
+        for(std::size_t i = 0 ; i < other.words.size() ; i++)
+            words[i] ^= other.words[i];
+        trim();
+        return *this;
+    }
+
+    friend DynamicBitset operator +(DynamicBitset a, const DynamicBitset& b) { a += b; return a; }
+    friend DynamicBitset operator -(DynamicBitset a, const DynamicBitset& b) { a -= b; return a; }
+    friend DynamicBitset operator &(DynamicBitset a, const DynamicBitset& b) { a &= b; return a; }
+    friend DynamicBitset operator ^(DynamicBitset a, const DynamicBitset& b) { a ^= b; return a; }
+
+    void serialize(BinaryWriter &writer) const { writer.write(words); }
+
+    void deserialize(BinaryReader &reader)
+    {
+        reader.read(words);
+        if(not words.empty() and words.back() == 0)
+            throw std::runtime_error("Bitset with a trailing zero word");
+    }
+
+protected:
+    void trim()
+    {
+        while(not words.empty() and words.back() == 0)
+            words.pop_back();
+    }
+
+    std::vector<std::uint64_t> words;
+};
+
+#endif // DYNAMIC_BITSET_H
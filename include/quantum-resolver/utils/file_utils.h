@@ -1,10 +1,18 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <filesystem>
 #include <vector>
+#include <cstdint>
+
+class Executor;
+
+/// \brief 'path', an absolute path of the system (e.g. /var/db/pkg), under the folder given by
+///        the QUANTUM_ROOT environment variable if set, e.g. to work on a test tree
+std::filesystem::path rooted_path(const std::filesystem::path &path);
 
 const extern std::vector<std::filesystem::path> flatenned_profiles_tree;
 
@@ -20,7 +28,116 @@ std::vector<std::pair<std::string, std::string>> read_unquoted_vars(const std::f
 
 std::vector<std::filesystem::path> get_regular_files(const std::filesystem::path &path);
 
+/// \brief sorted paths of the folders directly under 'path', empty if 'path' isn't a folder
+std::vector<std::filesystem::path> get_subdirectories(const std::filesystem::path &path);
+
+/// \brief modification time of 'path' in the filesystem clock ticks, 0 if it doesn't exist
+std::int64_t get_mtime(const std::filesystem::path &path);
+
 std::vector<std::string> read_file_lines(const std::filesystem::path& file_path);
 
+/// \brief puts the whole contents of 'file_path' in 'contents', with pread() calls
+/// \note  'contents' can be reused from one call to the next to avoid allocations
+void read_file_contents(const std::filesystem::path& file_path, std::string& contents);
+
+/// \brief reads every file of 'paths' in full and calls 'on_read(i, contents)' for each of them,
+///        with io_uring submitting the opens and reads of large batches at once when
+///        the kernel allows it, and with pread() calls spread over the workers otherwise
+/// \note  'on_read' is called from several threads at once, once per index, and the view
+///        only lives during the call. The files that cannot be opened are skipped
+void read_files(const std::vector<std::filesystem::path>& paths,
+                const std::function<void(std::size_t, std::string_view)>& on_read,
+                Executor &executor);
+
+/// \brief same, with 'on_read' called by the calling thread only, in the order of 'paths',
+///        e.g. by the reader threads of a pipeline that already run next to each other
+void read_files_in_order(const std::vector<std::filesystem::path>& paths,
+                         const std::function<void(std::size_t, std::string_view)>& on_read);
+
+/// \brief true if the calling thread reads the batches of read_files_in_order() with io_uring
+bool io_uring_reads_available();
+
+/// \brief grows the file descriptor table of the process once and for all to what read_files() needs
+/// \note  the kernel waits for an RCU grace period, i.e. milliseconds, each time it grows the table
+///        of a process with several threads (io_uring workers included): best called before
+///        starting any thread. read_files() calls it anyway
+void reserve_file_descriptors();
+
+/// \brief the lines read_file_lines() would give for a file holding 'contents'
+std::vector<std::string_view> get_lines(std::string_view contents);
+
 void print_file_contents(const std::filesystem::path& file_path);
 
+/// \brief read-only memory mapping of a whole file, unmapped on destruction
+/// \note  an empty file gives an empty view
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& file_path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator = (MappedFile&& other) noexcept;
+
+    ~MappedFile();
+
+    std::string_view view() const { return std::string_view(data, size); }
+
+protected:
+    void unmap();
+
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+/// \brief unquoted NAME=value variables, e.g. the ones of an md5-cache entry, packed in a single buffer
+/// \note  names and values are kept as offsets in that buffer: one allocation for all of them,
+///        views on them stay valid until the object is modified or destroyed
+class RawVars
+{
+public:
+    RawVars() = default;
+
+    /// \brief reads the variables of 'file_path' whose name is in 'names', the other ones are skipped
+    RawVars(const std::filesystem::path& file_path, const std::vector<std::string>& names);
+
+    /// \brief same, out of the contents of a file that has already been read
+    RawVars(std::string_view contents, const std::vector<std::string>& names);
+
+    void add(std::string_view name, std::string_view value);
+
+    bool contains(std::string_view name) const;
+
+    /// \brief value of the variable 'name', empty if there is none
+    std::string_view operator [](std::string_view name) const;
+
+    bool empty() const { return vars.empty(); }
+    void clear();
+
+protected:
+    struct Var
+    {
+        std::uint32_t name_start, name_size;
+        std::uint32_t value_start, value_size;
+    };
+
+    std::string buffer;
+    std::vector<Var> vars;
+};
+
+/// \brief writes 'content' to 'file_path' through a temporary file that is then renamed,
+///        so readers either see the previous file or the complete new one
+void write_file_atomically(const std::filesystem::path& file_path, std::string_view content);
+
+/// \brief resident memory of the process, current and highest so far, in kB
+struct MemoryUsage
+{
+    std::size_t resident_kb = 0, peak_resident_kb = 0;
+};
+
+/// \brief reads VmRSS and VmHWM from /proc/self/status, zeros where they can't be read
+MemoryUsage read_memory_usage();
+
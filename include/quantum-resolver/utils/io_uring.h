@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include <linux/io_uring.h>
+
+/// \brief minimal io_uring instance, set up with the raw system calls so liburing isn't needed
+/// \note  not thread-safe, each thread that submits work needs its own instance
+class IoUring
+{
+public:
+    /// \brief sets up a ring with 'entries' submission slots
+    /// \note  valid() is false when the kernel refuses it (too old, io_uring disabled by
+    ///        sysctl or seccomp...) or does not support one of the 'needed_ops'
+    explicit IoUring(unsigned entries, std::initializer_list<std::uint8_t> needed_ops = {});
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator = (const IoUring&) = delete;
+
+    bool valid() const { return ring_fd >= 0; }
+    unsigned capacity() const { return sq_entries; }
+
+    /// \brief next free submission entry, zeroed, nullptr if every slot is already queued
+    io_uring_sqe* get_sqe();
+
+    /// \brief submits what got queued since the last call, then waits until at least
+    ///        'wait_count' completions are available
+    void submit_and_wait(unsigned wait_count);
+
+    /// \brief calls 'func(user_data, result)' on every available completion and consumes them
+    /// \return the number of completions
+    template <class Func>
+    unsigned for_each_completion(Func&& func)
+    {
+        unsigned head = *cq_head;
+        const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+
+        unsigned count = 0;
+        for( ; head != tail ; head++, count++)
+        {
+            const io_uring_cqe &cqe = cqes[head & *cq_mask];
+            func(cqe.user_data, cqe.res);
+        }
+
+        std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+        in_flight -= count;
+        return count;
+    }
+
+    /// \brief drops the entries the kernel has not taken yet, then waits for the completion of
+    ///        every submitted one and calls 'func(user_data, result)' on each, e.g. to release
+    ///        what they hold once a submission failed halfway
+    /// \note  the ring has nothing pending anymore afterwards, unless this throws too
+    template <class Func>
+    void drain(Func&& func)
+    {
+        discard_unsubmitted();
+        while(in_flight != 0)
+        {
+            submit_and_wait(in_flight);
+            for_each_completion(func);
+        }
+    }
+
+protected:
+    void discard_unsubmitted();
+
+    int ring_fd = -1;
+
+    void *sq_ring = nullptr, *cq_ring = nullptr;
+    std::size_t sq_ring_size = 0, cq_ring_size = 0;
+
+    io_uring_sqe *sqes = nullptr;
+    std::size_t sqes_size = 0;
+
+    unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    unsigned sq_entries = 0;
+    unsigned queued = 0; // entries handed out by get_sqe() and not submitted yet
+    unsigned in_flight = 0; // entries taken by the kernel whose completion has not been consumed yet
+};
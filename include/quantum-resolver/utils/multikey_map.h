@@ -9,6 +9,8 @@
 #include <cassert>
 #include <limits>
 
+#include "quantum-resolver/utils/serialization.h"
+
 template <class Object, class... KeyType> requires (sizeof...(KeyType) > 0)
 class MultiKeyMap
 {
@@ -46,6 +48,17 @@ public:
     template<class AnyKey> requires (std::is_same_v<AnyKey, KeyType> || ...)
     std::size_t keys_count() const;
 
+    void serialize(BinaryWriter &writer) const
+    {
+        writer.write(std::tie(container, maps, rev_maps));
+    }
+
+    void deserialize(BinaryReader &reader)
+    {
+        auto members = std::tie(container, maps, rev_maps);
+        reader.read(members);
+    }
+
     static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
 
 protected:
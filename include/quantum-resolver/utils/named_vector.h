@@ -19,7 +19,7 @@ public:
     NamedVector() {};
 
     std::size_t size() const {return objects.size();};
-    bool empty() {return objects.back();};
+    bool empty() const {return objects.empty();};
     Object& back() {return objects.back();};
     iterator begin() {return objects.begin();};
     iterator end() {return objects.end();};
@@ -54,6 +54,17 @@ public:
         return index;
     }
 
+    void erase(std::size_t index)
+    {
+        // objects after 'index' shift down by one
+        name_to_index.erase(index_to_name[index]);
+        objects.erase(objects.begin() + long(index));
+        index_to_name.erase(index_to_name.begin() + long(index));
+
+        for(std::size_t i = index ; i < index_to_name.size() ; i++)
+            name_to_index[index_to_name[i]] = i;
+    }
+
     Object& operator [](const std::string_view &name)
     {
         auto it = name_to_index.find(name);
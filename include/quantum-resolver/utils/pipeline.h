@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// \brief what went through a pipeline stage, and how long its threads waited on the other stages
+struct StageCounters
+{
+    std::string name;
+
+    std::atomic<std::size_t> items = 0;
+    std::atomic<std::size_t> bytes = 0;
+
+    std::atomic<std::int64_t> starved_us = 0; // waiting for the previous stage to hand something
+    std::atomic<std::int64_t> blocked_us = 0; // waiting for room in the next queue, i.e. back-pressure
+};
+
+/// \brief queue between two pipeline stages, producers block while it holds 'capacity' items
+/// \note  every push or pop may wake up another thread: items are meant to be batches of work
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity) {}
+
+    /// \brief blocks while the queue is full
+    /// \return false if the queue got aborted, 'item' is dropped then
+    bool push(T item, StageCounters *counters = nullptr)
+    {
+        std::unique_lock lock(mutex);
+        if(items.size() >= capacity and not aborted)
+        {
+            auto start = std::chrono::steady_clock::now();
+            not_full.wait(lock, [this]{ return items.size() < capacity or aborted; });
+            if(counters)
+                counters->blocked_us += elapsed_us(start);
+        }
+
+        if(aborted)
+            return false;
+
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /// \brief blocks while the queue is empty
+    /// \return std::nullopt once the queue is closed and drained, or got aborted
+    std::optional<T> pop(StageCounters *counters = nullptr)
+    {
+        std::unique_lock lock(mutex);
+        if(items.empty() and not closed and not aborted)
+        {
+            auto start = std::chrono::steady_clock::now();
+            not_empty.wait(lock, [this]{ return not items.empty() or closed or aborted; });
+            if(counters)
+                counters->starved_us += elapsed_us(start);
+        }
+
+        if(aborted or items.empty())
+            return std::nullopt;
+
+        std::optional<T> item(std::move(items.front()));
+        items.pop_front();
+
+        not_full.notify_one();
+        return item;
+    }
+
+    /// \brief nothing more gets pushed: the consumers drain what is left, then pop() returns std::nullopt
+    void close()
+    {
+        std::scoped_lock lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+    /// \brief drops what is queued and wakes everyone up, e.g. when a stage failed
+    void abort()
+    {
+        std::scoped_lock lock(mutex);
+        aborted = true;
+        items.clear();
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+protected:
+    static std::int64_t elapsed_us(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const std::size_t capacity;
+
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+    std::deque<T> items;
+    bool closed = false, aborted = false;
+};
+
+/// \brief the threads of a pipeline: each stage reads from the queue the previous one fills
+/// \note  the first exception thrown by a stage aborts every registered queue, so that
+///        no thread stays blocked, then gets rethrown by join()
+class Pipeline
+{
+public:
+    Pipeline() = default;
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator = (const Pipeline&) = delete;
+
+    ~Pipeline()
+    {
+        // e.g. the calling thread threw while consuming the last queue
+        if(not threads.empty())
+        {
+            abort();
+            for(auto &thread: threads)
+                thread.join();
+        }
+    }
+
+    /// \brief the queue gets aborted if any stage fails
+    template <class T>
+    void add_queue(BoundedQueue<T> &queue)
+    {
+        abort_funcs.push_back([&queue]{ queue.abort(); });
+    }
+
+    /// \brief starts 'threads_num' threads running 'func', the last one to return calls 'on_done',
+    ///        typically to close the queue the stage fills, the last stage has none
+    StageCounters& add_stage(std::string name, std::size_t threads_num,
+                             std::function<void(StageCounters&)> func, std::function<void()> on_done = {})
+    {
+        StageCounters &counters = stages.emplace_back();
+        counters.name = std::move(name);
+
+        auto remaining = std::make_shared<std::atomic<std::size_t>>(threads_num);
+        for(std::size_t t = 0 ; t < threads_num ; t++)
+            threads.emplace_back([this, &counters, func, on_done, remaining]()
+            {
+                try
+                {
+                    func(counters);
+                }
+                catch(...)
+                {
+                    fail(std::current_exception());
+                }
+
+                if(--*remaining == 0 and on_done)
+                    on_done();
+            });
+
+        return counters;
+    }
+
+    /// \brief waits for every stage, then rethrows the first exception one of them threw
+    void join()
+    {
+        for(auto &thread: threads)
+            thread.join();
+        threads.clear();
+
+        if(first_exception)
+            std::rethrow_exception(first_exception);
+    }
+
+    const std::list<StageCounters>& get_stages() const { return stages; }
+
+protected:
+    void fail(std::exception_ptr exception)
+    {
+        {
+            std::scoped_lock lock(exception_mutex);
+            if(first_exception)
+                return;
+            first_exception = exception;
+        }
+        abort();
+    }
+
+    void abort()
+    {
+        for(auto &abort_func: abort_funcs)
+            abort_func();
+    }
+
+    std::list<StageCounters> stages; // a list, threads keep references to their counters
+    std::vector<std::thread> threads;
+    std::vector<std::function<void()>> abort_funcs;
+
+    std::mutex exception_mutex;
+    std::exception_ptr first_exception;
+};
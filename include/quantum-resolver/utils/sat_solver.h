@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// \brief CDCL boolean satisfiability solver: two watched literals per clause,
+///        first-UIP clause learning, VSIDS branching, Luby restarts and phase saving
+/// \note  literals are encoded as 2 * var + negated, see SatSolver::pos() and SatSolver::neg()
+class SatSolver
+{
+public:
+    using Var = std::uint32_t;
+    using Lit = std::uint32_t;
+
+    static Lit pos(Var var) { return 2 * var; }
+    static Lit neg(Var var) { return 2 * var + 1; }
+    static Lit negate(Lit lit) { return lit ^ 1; }
+    static Var var_of(Lit lit) { return lit >> 1; }
+    static bool is_negated(Lit lit) { return lit & 1; }
+
+    /// \param preferred_state: the value given to the variable the first time it gets decided
+    /// \param initial_activity: variables with the highest activity get decided first
+    Var new_var(bool preferred_state = false, double initial_activity = 0);
+
+    /// \brief clauses can only be added before solve() is called
+    void add_clause(std::vector<Lit> lits);
+
+    /// \brief at most one of 'lits' can be true
+    void add_at_most_one(const std::vector<Lit> &lits);
+
+    enum struct Result {SATISFIABLE, UNSATISFIABLE};
+    Result solve();
+
+    /// \brief value of 'var' in the model found by the last successful solve()
+    bool value(Var var) const { return assigns[var] == Value::TRUE; }
+    bool value_of(Lit lit) const { return value(var_of(lit)) != is_negated(lit); }
+
+    std::size_t vars_count() const { return assigns.size(); }
+    std::size_t clauses_count() const { return clauses.size(); }
+
+    struct Stats
+    {
+        std::uint64_t decisions = 0, propagations = 0, conflicts = 0, restarts = 0, learnt_clauses = 0;
+    };
+    const Stats& get_stats() const { return stats; }
+
+protected:
+    enum struct Value : std::int8_t {FALSE, TRUE, UNASSIGNED};
+
+    using ClauseRef = std::uint32_t;
+    static constexpr ClauseRef no_reason = std::numeric_limits<ClauseRef>::max();
+
+    struct Clause
+    {
+        std::vector<Lit> lits; // lits[0] and lits[1] are watched
+        bool learnt = false;
+        std::uint32_t lbd = 0; // number of distinct decision levels when learnt, lower is better
+    };
+
+    struct Watcher
+    {
+        ClauseRef clause;
+        Lit blocker; // another literal of the clause, the clause is satisfied if it is true
+    };
+
+    Value value_lit(Lit lit) const;
+    int decision_level() const { return int(trail_limits.size()); }
+
+    ClauseRef attach_clause(std::vector<Lit> lits, bool learnt);
+    void enqueue(Lit lit, ClauseRef reason);
+    ClauseRef propagate();
+    void analyze(ClauseRef conflict, std::vector<Lit> &learnt, int &backtrack_level, std::uint32_t &lbd);
+    bool redundant(Lit lit) const;
+    void backtrack(int level);
+    Lit pick_branch_lit();
+    void reduce_learnts();
+    void rebuild_watches();
+
+    void bump_var(Var var);
+    void decay_activities() { var_increment /= var_decay; }
+
+    // binary max heap of the variables, ordered by activity
+    void heap_insert(Var var);
+    Var heap_pop();
+    void heap_sift_up(std::size_t index);
+    void heap_sift_down(std::size_t index);
+    bool heap_contains(Var var) const { return heap_index[var] != npos; }
+
+    static double luby(double y, std::uint64_t x);
+
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    std::vector<Clause> clauses;
+    std::vector<std::vector<Watcher>> watches; // indexed by literal: clauses watching its negation
+
+    std::vector<Value> assigns;
+    std::vector<bool> saved_phase;
+    std::vector<int> levels;
+    std::vector<ClauseRef> reasons;
+
+    std::vector<Lit> trail;
+    std::vector<std::size_t> trail_limits; // trail size at each decision
+    std::size_t propagation_head = 0;
+
+    std::vector<double> activity;
+    double var_increment = 1, var_decay = 0.95;
+    std::vector<Var> heap;
+    std::vector<std::size_t> heap_index;
+
+    mutable std::vector<bool> seen;
+
+    std::size_t learnts_count = 0;
+    bool ok = true; // false once an empty clause has been derived
+
+    Stats stats;
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+class BinaryWriter;
+class BinaryReader;
+
+/// \brief classes that save and restore themselves
+template <class T>
+concept SelfSerializable = requires(const T& ct, T& t, BinaryWriter& writer, BinaryReader& reader)
+{
+    ct.serialize(writer);
+    t.deserialize(reader);
+};
+
+/// \brief plain structs that expose their members as a tuple of references with
+///        static auto tie_members(auto& self) { return std::tie(self.a, self.b); }
+template <class T>
+concept MemberTiable = requires(T& t, const T& ct)
+{
+    T::tie_members(t);
+    T::tie_members(ct);
+};
+
+template <class T>
+struct is_pair : std::false_type {};
+template <class A, class B>
+struct is_pair<std::pair<A, B>> : std::true_type {};
+
+template <class T>
+struct is_tuple : std::false_type {};
+template <class... Ts>
+struct is_tuple<std::tuple<Ts...>> : std::true_type {};
+
+template <class T>
+struct is_vector : std::false_type {};
+template <class T, class A>
+struct is_vector<std::vector<T, A>> : std::true_type {};
+
+template <class T>
+concept Associative = requires(T& t) { typename T::key_type; t.clear(); t.size(); };
+
+template <class T>
+struct is_byte_array : std::false_type {};
+template <std::size_t N>
+struct is_byte_array<std::array<unsigned char, N>> : std::true_type {};
+
+/// \brief the last value of an enum that gets deserialized, its values going from 0 to it, e.g.
+///        template <> struct SerializedEnum<Color> { static constexpr Color last = Color::BLUE; };
+/// \note  left undefined: reading an enum without it does not compile
+template <class T>
+struct SerializedEnum;
+
+/// \brief binary encoding of the in-memory state, see BinaryReader for the decoding
+/// \note  the encoding is native endian and native sized, it is only meant to be read back
+///        by the same build on the same machine
+class BinaryWriter
+{
+public:
+    template <class T>
+    void write(const T& value)
+    {
+        if constexpr (SelfSerializable<T>)
+            value.serialize(*this);
+        else if constexpr (MemberTiable<T>)
+            write(T::tie_members(value));
+        else if constexpr (std::is_same_v<T, std::string>)
+            write_string(value);
+        else if constexpr (std::is_same_v<T, std::filesystem::path>)
+            write_string(value.string());
+        else if constexpr (is_pair<T>::value)
+        {
+            write(value.first);
+            write(value.second);
+        }
+        else if constexpr (is_tuple<T>::value)
+            std::apply([this](const auto&... elements){ (write(elements), ...); }, value);
+        else if constexpr (is_vector<T>::value or Associative<T>)
+        {
+            write(std::uint64_t(value.size()));
+            for(const auto& element: value)
+                write(element);
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>)
+            write_bytes(&value, sizeof(T));
+        else static_assert(dependent_false<T>, "Type cannot be serialized");
+    }
+
+    void write_bytes(const void* data, std::size_t size)
+    {
+        buffer.append(static_cast<const char*>(data), size);
+    }
+
+    const std::string& data() const { return buffer; }
+
+protected:
+    template <class T>
+    static constexpr bool dependent_false = false;
+
+    void write_string(std::string_view str)
+    {
+        write(std::uint64_t(str.size()));
+        write_bytes(str.data(), str.size());
+    }
+
+    std::string buffer;
+};
+
+/// \brief decodes what BinaryWriter encoded, from a memory region that it does not own
+///        (typically a mapped snapshot file), into regular heap allocated containers
+/// \note  throws std::runtime_error when the region ends before the value does, or when
+///        a bool, an enum or a container size cannot have been written by BinaryWriter.
+///        Structs are read member by member, never copied as a whole: IDs are left to
+///        the classes that know their range
+class BinaryReader
+{
+public:
+    explicit BinaryReader(std::string_view data) : data(data) {}
+
+    template <class T>
+    void read(T& value)
+    {
+        if constexpr (SelfSerializable<T>)
+            value.deserialize(*this);
+        else if constexpr (MemberTiable<T>)
+        {
+            auto members = T::tie_members(value);
+            read(members);
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+            value = std::string(read_string());
+        else if constexpr (std::is_same_v<T, std::filesystem::path>)
+            value = std::filesystem::path(read_string());
+        else if constexpr (is_pair<T>::value)
+        {
+            read(value.first);
+            read(value.second);
+        }
+        else if constexpr (is_tuple<T>::value)
+            std::apply([this](auto&... elements){ (read(elements), ...); }, value);
+        else if constexpr (is_vector<T>::value)
+        {
+            value.clear();
+            value.resize(read_size());
+            for(auto& element: value)
+                read(element);
+        }
+        else if constexpr (Associative<T>)
+        {
+            value.clear();
+            std::size_t size = read_size();
+            for(std::size_t i = 0 ; i < size ; i++)
+            {
+                // map value types have a const key, read into a mutable pair instead
+                if constexpr (requires { typename T::mapped_type; })
+                {
+                    std::pair<typename T::key_type, typename T::mapped_type> element;
+                    read(element);
+                    value.insert(std::move(element));
+                }
+                else
+                {
+                    typename T::value_type element;
+                    read(element);
+                    value.insert(std::move(element));
+                }
+            }
+        }
+        else if constexpr (std::is_same_v<T, bool>)
+        {
+            unsigned char byte;
+            std::memcpy(&byte, read_bytes(sizeof(bool)), sizeof(bool));
+            if(byte > 1)
+                throw std::runtime_error("Invalid boolean");
+            value = byte;
+        }
+        else if constexpr (std::is_enum_v<T>)
+        {
+            using Underlying = std::make_unsigned_t<std::underlying_type_t<T>>;
+
+            Underlying underlying;
+            std::memcpy(&underlying, read_bytes(sizeof(T)), sizeof(T));
+            if(underlying > Underlying(SerializedEnum<T>::last))
+                throw std::runtime_error("Invalid enum value");
+            value = T(underlying);
+        }
+        else if constexpr (std::is_arithmetic_v<T> or is_byte_array<T>::value)
+            std::memcpy(&value, read_bytes(sizeof(T)), sizeof(T));
+        else static_assert(dependent_false<T>, "Type cannot be deserialized");
+    }
+
+    template <class T>
+    T read()
+    {
+        T value;
+        read(value);
+        return value;
+    }
+
+    const char* read_bytes(std::size_t size)
+    {
+        if(size > data.size() - position)
+            throw std::runtime_error("Binary data ends unexpectedly");
+
+        const char* bytes = data.data() + position;
+        position += size;
+        return bytes;
+    }
+
+    bool at_end() const { return position == data.size(); }
+
+protected:
+    template <class T>
+    static constexpr bool dependent_false = false;
+
+    std::string_view read_string()
+    {
+        std::size_t size = read<std::uint64_t>();
+        return std::string_view(read_bytes(size), size);
+    }
+
+    /// \brief a container size, every element taking at least a byte
+    std::size_t read_size()
+    {
+        std::size_t size = read<std::uint64_t>();
+        if(size > data.size() - position)
+            throw std::runtime_error("Container size beyond the end of the binary data");
+        return size;
+    }
+
+    std::string_view data;
+    std::size_t position = 0;
+};
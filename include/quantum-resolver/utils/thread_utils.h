@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \brief default number of threads of an Executor, at least one: the QUANTUM_JOBS
+///        environment variable if set, the number of CPUs otherwise
+std::size_t worker_count();
+
+/// \brief pool of threads shared by everything that runs in parallel, owned by the Database
+/// \note  every thread has its own task queue: it runs its newest tasks first and, once it has
+///        none left, steals the oldest ones of the other threads. Higher priority tasks are
+///        taken first, wherever they are queued
+/// \note  a thread waiting for its tasks runs tasks meanwhile, so fork/join can be nested
+/// \note  a forked child (e.g. the daemon answering a client) has no worker thread anymore:
+///        everything runs on the calling thread there
+class Executor
+{
+public:
+    enum struct Priority {HIGH, NORMAL, LOW};
+
+    /// \param workers_num: threads running tasks, the calling thread of wait() included,
+    ///                     so 'workers_num' - 1 threads get started
+    explicit Executor(std::size_t workers_num = worker_count());
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator = (const Executor&) = delete;
+
+    std::size_t size() const { return workers_num; }
+
+    /// \brief tasks forked together and joined by wait()
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(Executor &executor, Priority priority = Priority::NORMAL);
+
+        /// \note waits for the tasks still running, their exceptions are lost then
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator = (const TaskGroup&) = delete;
+
+        void run(std::function<void()> task);
+
+        /// \brief runs tasks until every task of the group is done, then rethrows
+        ///        the first exception one of them threw
+        void wait();
+
+    protected:
+        friend class Executor;
+
+        void fail(std::exception_ptr exception);
+
+        Executor &executor;
+        Priority priority;
+
+        std::atomic<std::size_t> pending = 0;
+
+        std::mutex exception_mutex;
+        std::exception_ptr first_exception;
+    };
+
+    /// \brief calls 'func(i)' for every i in [0, n), on up to size() threads
+    /// \note  indices are handed out one at a time so uneven work items balance out,
+    ///        'func' must only touch state that belongs to index i (or is thread-safe)
+    /// \note  the first exception thrown by 'func' is rethrown in the calling thread
+    ///        once every index being worked on is done
+    template <class Func>
+    void parallel_for(std::size_t n, Func&& func, Priority priority = Priority::NORMAL);
+
+protected:
+    struct Task
+    {
+        std::function<void()> func;
+        TaskGroup *group;
+    };
+
+    static constexpr std::size_t priorities_num = 3;
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::array<std::deque<Task>, priorities_num> tasks; // indexed by priority
+    };
+
+    void push(Task task, Priority priority);
+
+    /// \brief runs one queued task, if any
+    /// \return false if there was none
+    bool run_one();
+    bool pop(Task &task);
+
+    void work(std::size_t worker_index);
+
+    /// \brief true in a child forked after the worker threads got started
+    bool forked() const;
+
+    std::size_t workers_num;
+    int owner_pid;
+
+    // one per worker thread, the last one is shared by the other threads
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::atomic<std::size_t> queued_tasks = 0;
+
+    // idle threads sleep on 'wake', so do the threads waiting for a group with nothing to run
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+template <class Func>
+void Executor::parallel_for(std::size_t n, Func&& func, Priority priority)
+{
+    const std::size_t tasks_num = std::min(workers_num, n);
+    if(tasks_num <= 1 or forked())
+    {
+        for(std::size_t i = 0 ; i < n ; i++)
+            func(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next_index = 0;
+    auto loop = [&]()
+    {
+        try
+        {
+            for(std::size_t i = next_index++ ; i < n ; i = next_index++)
+                func(i);
+        }
+        catch(...)
+        {
+            // make the other tasks run out of indices
+            next_index = n;
+            throw;
+        }
+    };
+
+    TaskGroup group(*this, priority);
+    for(std::size_t t = 0 ; t < tasks_num - 1 ; t++)
+        group.run(loop);
+
+    // the calling thread works too, and must not leave before the tasks that use its stack
+    std::exception_ptr exception;
+    try
+    {
+        loop();
+    }
+    catch(...)
+    {
+        exception = std::current_exception();
+    }
+
+    try
+    {
+        group.wait();
+    }
+    catch(...)
+    {
+        if(not exception)
+            exception = std::current_exception();
+    }
+
+    if(exception)
+        std::rethrow_exception(exception);
+}
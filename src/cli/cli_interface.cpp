@@ -3,11 +3,100 @@
 #include "quantum-resolver/utils/string_utils.h"
 #include "quantum-resolver/cli/table_print.h"
 #include "quantum-resolver/utils/misc_utils.h"
+#include "quantum-resolver/resolver.h"
 
-CommandLineInterface::CommandLineInterface(std::vector<std::string> input)
+#include <chrono>
+
+CommandLineInterface::CommandLineInterface(Database &db) : db(db)
+{
+}
+
+void CommandLineInterface::run(const std::vector<std::string> &input)
 {
     if(input.size() == 2 and input[0] == "status")
         print_pkg_status(input[1]);
+    else if(input.size() >= 2 and input[0] == "resolve")
+        resolve(std::vector<std::string>(input.begin() + 1, input.end()));
+}
+
+void CommandLineInterface::resolve(const std::vector<std::string> &atom_strs)
+{
+    std::vector<PackageDependency> atoms;
+    for(const auto& atom_str: atom_strs)
+    {
+        if(atom_str == "@world" or atom_str == "@system" or atom_str == "@selected")
+        {
+            std::unordered_set<PackageID> set_pkgs;
+            if(atom_str != "@selected")
+                set_pkgs += db.repo.get_system_pkgs();
+            if(atom_str != "@system")
+                set_pkgs += db.repo.get_selected_pkgs();
+
+            for(PackageID pkg_id: set_pkgs)
+            {
+                PackageDependency atom;
+                atom.pkg_constraint.pkg_id = pkg_id;
+                atoms.push_back(std::move(atom));
+            }
+            continue;
+        }
+
+        atoms.push_back(db.parser.parse_pkg_dependency(atom_str));
+        if(atoms.back().pkg_constraint.pkg_id == db.repo.npos)
+        {
+            fmt::print("Invalid atom: {}\n", atom_str);
+            return;
+        }
+    }
+
+    std::cout << "Resolving dependencies" << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Resolver resolver(&db);
+    Resolution resolution = resolver.resolve(atoms);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    fmt::print("Solved {} variables and {} clauses with {} conflicts in : {}ms\n",
+               resolution.vars_count, resolution.clauses_count, resolution.solver_stats.conflicts,
+               std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+    if(not resolution.solved)
+    {
+        fmt::print(fmt::fg(gentoo_red) | fmt::emphasis::bold, "No set of ebuilds satisfies the dependencies\n");
+        return;
+    }
+
+    std::size_t to_build = 0;
+    for(const auto& resolved: resolution.ebuilds)
+    {
+        if(resolved.up_to_date)
+            continue;
+
+        auto& pkg = db.repo[resolved.pkg_id];
+        auto& ebuild = pkg[resolved.ebuild_id];
+
+        // N: new package, U: other version installed, R: same version with other flags
+        bool other_version_installed = std::ranges::any_of(pkg, [](const Ebuild& other){ return other.is_installed(); });
+        std::string_view kind = ebuild.is_installed() ? "R" : (other_version_installed ? "U" : "N");
+
+        const auto& flag_index = pkg.get_flag_index();
+        auto pretty_formatting = pretty_format_flags(
+                    db.useflags,
+                    flag_index.to_flag_ids(resolved.active_flags & ebuild.get_iuse()),
+                    flag_index.to_flag_ids(ebuild.get_iuse() - resolved.active_flags),
+                    flag_index.to_flag_ids(ebuild.get_enforced_flags()),
+                    flag_index.to_flag_ids(ebuild.is_installed() ? resolved.active_flags ^ ebuild.get_install_active_flags()
+                                                                 : DynamicBitset()));
+
+        std::string flags;
+        for(const auto& [expand_name, flag_formatting]: pretty_formatting)
+            flags += fmt::format(" {}=\"{}\"", expand_name, concatenate(flag_formatting, " "));
+
+        fmt::print("[ebuild  {}  ] {}-{}{}\n", kind, pkg.get_pkg_groupname(), ebuild.get_version().string(), flags);
+        to_build++;
+    }
+
+    fmt::print("\nTotal: {} ebuilds to build, {} already up to date\n", to_build, resolution.ebuilds.size() - to_build);
 }
 
 void CommandLineInterface::print_pkg_status(const std::string &package_constraint_str)
@@ -24,10 +113,13 @@ void CommandLineInterface::print_pkg_status(const std::string &package_constrain
     if(matched_ebuild_ids.empty())
         return;
 
+    // flag sets of the same package share their local flag IDs
+    const auto& flag_index = pkg.get_flag_index();
+
     bool first = true;
-    std::unordered_set<FlagID> shared_iuse, shared_use, shared_use_force, shared_use_mask, non_shared_flags;
+    DynamicBitset shared_iuse, shared_use, shared_use_force, shared_use_mask, non_shared_flags;
 
-    auto intersect_or_assign = [&first, &non_shared_flags](std::unordered_set<FlagID>& to, const std::unordered_set<FlagID>& from)
+    auto intersect_or_assign = [&first, &non_shared_flags](DynamicBitset& to, const DynamicBitset& from)
     {
         if(first)
             to = from;
@@ -52,15 +144,12 @@ void CommandLineInterface::print_pkg_status(const std::string &package_constrain
         first = false;
     }
 
-    auto shared_use_force_strs = db.useflags.to_flag_names(shared_use_force);
-    auto shared_use_mask_strs = db.useflags.to_flag_names(shared_use_mask);
-
     auto shared_active_flags = shared_use + shared_use_force - shared_use_mask;
     auto pretty_formatting = pretty_format_flags(
                 db.useflags,
-                (shared_active_flags & shared_iuse) - non_shared_flags,
-                (shared_iuse - shared_active_flags) - non_shared_flags,
-                (shared_use_force + shared_use_mask));
+                flag_index.to_flag_ids((shared_active_flags & shared_iuse) - non_shared_flags),
+                flag_index.to_flag_ids((shared_iuse - shared_active_flags) - non_shared_flags),
+                flag_index.to_flag_ids(shared_use_force + shared_use_mask));
 
     std::cout << std::string(30, '#') << std::endl;
     fmt::print(fmt::fg(gentoo_green) | fmt::emphasis::bold, "{}", package_constraint_str);
@@ -125,16 +214,16 @@ void CommandLineInterface::print_pkg_status(const std::string &package_constrain
                                                format_keyword(ebuild.get_arch_keyword()),
                                                format_bool(ebuild.is_keyword_accepted()));
 
-        auto ebuild_active_flags = ebuild.get_active_flags();
+        const auto& ebuild_active_flags = ebuild.get_active_flags();
 
         if(not non_shared_flags.empty())
         {
             auto pretty_formatting = pretty_format_flags(
                         db.useflags,
-                        (ebuild_active_flags & ebuild.get_iuse()) & non_shared_flags,
-                        (ebuild.get_iuse() - ebuild_active_flags) & non_shared_flags,
-                        ebuild.get_enforced_flags() & non_shared_flags,
-                        ebuild.get_changed_flags());
+                        flag_index.to_flag_ids((ebuild_active_flags & ebuild.get_iuse()) & non_shared_flags),
+                        flag_index.to_flag_ids((ebuild.get_iuse() - ebuild_active_flags) & non_shared_flags),
+                        flag_index.to_flag_ids(ebuild.get_enforced_flags() & non_shared_flags),
+                        flag_index.to_flag_ids(ebuild.get_changed_flags()));
 
             size_t index = 0;
             for(const auto& [expand_name, flag_formatting]: pretty_formatting)
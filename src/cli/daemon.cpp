@@ -0,0 +1,451 @@
+#include "quantum-resolver/cli/daemon.h"
+#include "quantum-resolver/cli/cli_interface.h"
+#include "quantum-resolver/utils/file_utils.h"
+
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+using namespace std;
+using namespace std::chrono;
+namespace fs = filesystem;
+
+namespace
+{
+
+/// \brief the events that can make Database::refresh() find something new
+constexpr uint32_t watched_events = IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+/// \brief how long the watched folders have to stay quiet before refreshing on our own,
+///        so that an emerge or a sync is handled in one go rather than file by file
+constexpr int quiet_period_ms = 200;
+
+/// \brief how long a client can take to send its request or to read a chunk of the answer
+constexpr time_t client_timeout_s = 10;
+
+sockaddr_un make_address(const fs::path &path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    const string &path_str = path.string();
+    if(path_str.size() >= sizeof(address.sun_path))
+        throw runtime_error("The socket path " + path_str + " is too long");
+
+    memcpy(address.sun_path, path_str.c_str(), path_str.size() + 1);
+    return address;
+}
+
+/// \brief a connected socket to 'path', -1 if nobody listens there
+int connect_to(const fs::path &path)
+{
+    sockaddr_un address = make_address(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+        return -1;
+
+    if(connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/// \brief the folder of the socket when there is no XDG_RUNTIME_DIR, e.g. /tmp/quantum-resolver-1000
+fs::path fallback_socket_dir()
+{
+    return fs::temp_directory_path() / fmt::format("quantum-resolver-{}", geteuid());
+}
+
+/// \brief whether 'dir' is a real folder that only we can get into: anyone can create
+///        a folder named like ours in /tmp first, or a symlink pointing elsewhere
+bool is_private_dir(const fs::path &dir)
+{
+    struct stat dir_stat;
+    return lstat(dir.c_str(), &dir_stat) == 0 and S_ISDIR(dir_stat.st_mode)
+           and dir_stat.st_uid == geteuid() and (dir_stat.st_mode & 077) == 0;
+}
+
+/// \brief whether the process listening on the other side of 'fd' runs as us, or as root
+bool trusted_peer(int fd)
+{
+    ucred peer;
+    socklen_t peer_size = sizeof(peer);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_size) == 0
+           and (peer.uid == geteuid() or peer.uid == 0);
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+    while(size != 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if(written < 0 and errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+} // namespace
+
+Daemon::Daemon()
+{
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotify_fd < 0)
+        throw runtime_error(string("Cannot initialize inotify: ") + strerror(errno));
+
+    watch_sources();
+
+    // what changed while the database was loading happened before the watches existed
+    db.refresh();
+
+    fs::path path = socket_path();
+    error_code ec;
+    if(path.parent_path() == fallback_socket_dir())
+    {
+        if(mkdir(path.parent_path().c_str(), 0700) != 0 and errno != EEXIST)
+            throw runtime_error("Cannot create " + path.parent_path().string() + ": " + strerror(errno));
+        if(not is_private_dir(path.parent_path()))
+            throw runtime_error(path.parent_path().string() + " is not a folder only accessible by this user");
+    }
+    else fs::create_directories(path.parent_path(), ec);
+
+    if(int fd = connect_to(path) ; fd >= 0)
+    {
+        close(fd);
+        throw runtime_error("A daemon already listens on " + path.string());
+    }
+    // left behind by a daemon that got killed
+    fs::remove(path, ec);
+
+    sockaddr_un address = make_address(path);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0
+       or bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+       or listen(listen_fd, SOMAXCONN) != 0)
+        throw runtime_error("Cannot listen on " + path.string() + ": " + strerror(errno));
+
+    cout << "Listening on " << path.string() << endl;
+}
+
+Daemon::~Daemon()
+{
+    if(listen_fd >= 0)
+    {
+        close(listen_fd);
+        error_code ec;
+        fs::remove(socket_path(), ec);
+    }
+
+    if(inotify_fd >= 0)
+        close(inotify_fd);
+}
+
+fs::path Daemon::socket_path()
+{
+    if(const char* env_path = getenv("QUANTUM_SOCKET"))
+        return fs::path(env_path);
+
+    if(geteuid() == 0)
+        return "/run/quantum-resolver.sock";
+
+    if(const char* xdg_runtime = getenv("XDG_RUNTIME_DIR"); xdg_runtime != nullptr and *xdg_runtime != '\0')
+        return fs::path(xdg_runtime) / "quantum-resolver.sock";
+
+    return fallback_socket_dir() / "daemon.sock";
+}
+
+bool Daemon::forward(const vector<string> &input)
+{
+    const fs::path path = socket_path();
+    if(path.parent_path() == fallback_socket_dir() and not is_private_dir(path.parent_path()))
+        return false;
+
+    int fd = connect_to(path);
+    if(fd < 0)
+        return false;
+
+    // the answer gets printed as is, it has to come from a daemon we started
+    if(not trusted_peer(fd))
+    {
+        close(fd);
+        cout << "Ignoring " << path.string() << ": the daemon listening there belongs to another user" << endl;
+        return false;
+    }
+
+    string request;
+    for(const string &arg: input)
+    {
+        request += arg;
+        request += '\0';
+    }
+
+    if(not write_all(fd, request.data(), request.size()))
+    {
+        close(fd);
+        return false;
+    }
+    shutdown(fd, SHUT_WR);
+
+    char buffer[1 << 16];
+    ssize_t read_size;
+    while((read_size = read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if(read_size < 0 and errno == EINTR)
+            continue;
+        if(read_size < 0 or not write_all(STDOUT_FILENO, buffer, read_size))
+            break;
+    }
+
+    close(fd);
+    return true;
+}
+
+void Daemon::watch(const fs::path &dir, int depth, bool source)
+{
+    // a missing folder (e.g. no /etc/portage/profile) has nothing to report
+    int wd = inotify_add_watch(inotify_fd, dir.c_str(), watched_events | IN_ONLYDIR);
+    if(wd < 0)
+        return;
+
+    watches[wd] = Watch{dir, depth, source};
+
+    if(depth > 0)
+        for(const auto &subdir: get_subdirectories(dir))
+            watch(subdir, depth - 1);
+}
+
+void Daemon::watch_sources()
+{
+    // Repo::refresh() looks at the category folders, then at the entries of the changed ones
+    watch(Repo::md5_cache_path, 1, true);
+    watch(Repo::selected_pkgs_path.parent_path(), 0, true);
+
+    // down to the files of each entry, e.g. a USE file rewritten in place
+    watch(Repo::installed_pkgs_path, 2, true);
+
+    // profiles and /etc/portage, with their package.use/ like folders
+    for(const auto &profile_path: flatenned_profiles_tree)
+    {
+        watch(profile_path, 0, true);
+        for(const auto &subdir: get_subdirectories(profile_path))
+            if(subdir.filename().string().starts_with("package"))
+                watch(subdir, 2, true);
+    }
+}
+
+void Daemon::read_events()
+{
+    alignas(inotify_event) char buffer[1 << 16];
+
+    ssize_t read_size;
+    while((read_size = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for(char* ptr = buffer ; ptr < buffer + read_size ; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            auto it = watches.find(event->wd);
+            if(it == watches.end())
+            {
+                // e.g. the queue overflowed
+                dirty = true;
+                continue;
+            }
+
+            const Watch parent = it->second;
+            const string name = event->len != 0 ? event->name : "";
+
+            if(event->mask & IN_IGNORED)
+            {
+                watches.erase(it);
+                lost_watches = lost_watches or parent.source;
+                if(parent.source)
+                    dirty = true;
+                continue;
+            }
+
+            // e.g. /var/db/pkg/sys-devel/gcc-12.2.1, or a file in it. Portage merges into
+            // a -MERGING-gcc-12.2.1 folder that gets renamed once complete
+            if(parent.dir.parent_path() == Repo::installed_pkgs_path and not name.empty())
+            {
+                if(not name.starts_with("-") and (event->mask & IN_ISDIR))
+                    installed_entries.emplace(parent.dir.filename().string(), name);
+            }
+            else if(parent.dir.parent_path().parent_path() == Repo::installed_pkgs_path)
+            {
+                if(not parent.dir.filename().string().starts_with("-"))
+                    installed_entries.emplace(parent.dir.parent_path().filename().string(), parent.dir.filename().string());
+                continue;
+            }
+            else dirty = true;
+
+            // e.g. a new category, or a new package.use/ subfolder
+            if((event->mask & IN_ISDIR) and (event->mask & (IN_CREATE | IN_MOVED_TO))
+               and parent.depth > 0 and not name.empty() and not name.starts_with("-"))
+                watch(parent.dir / name, parent.depth - 1);
+        }
+    }
+}
+
+void Daemon::serve()
+{
+    // a client leaving early must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    pollfd fds[2] = {{listen_fd, POLLIN, 0}, {inotify_fd, POLLIN, 0}};
+
+    while(true)
+    {
+        int ready = poll(fds, 2, has_pending_changes() ? quiet_period_ms : -1);
+        if(ready < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw runtime_error(string("poll() failed: ") + strerror(errno));
+        }
+
+        if(ready == 0)
+        {
+            refresh();
+            continue;
+        }
+
+        if(fds[1].revents & POLLIN)
+            read_events();
+
+        if(fds[0].revents & POLLIN)
+        {
+            int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if(client_fd < 0)
+                continue;
+
+            // the answer must reflect what is on disk right now
+            read_events();
+            if(has_pending_changes())
+                refresh();
+
+            answer(client_fd);
+        }
+    }
+}
+
+void Daemon::refresh()
+{
+    auto start = high_resolution_clock::now();
+
+    // e.g. /etc/portage got replaced as a whole
+    if(lost_watches)
+    {
+        lost_watches = false;
+        watch_sources();
+    }
+
+    // first, so that the entries below are applied on top of the categories it read again
+    const bool full_refresh = dirty;
+    if(full_refresh)
+        db.refresh();
+    dirty = false;
+
+    size_t changed_entries = 0;
+    for(const auto &[category, pkg_namever]: installed_entries)
+    {
+        try
+        {
+            changed_entries += db.repo.refresh_installed_entry(category, pkg_namever);
+        }
+        catch(runtime_error &err)
+        {
+            // e.g. a folder that isn't named like an ebuild, the daemon keeps going
+            cout << category << "/" << pkg_namever << ": " << err.what() << endl;
+        }
+    }
+    installed_entries.clear();
+
+    auto end = high_resolution_clock::now();
+    cout << "Refreshed " << (full_refresh ? "the database and " : "") << changed_entries
+         << " installed entries in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+}
+
+void Daemon::answer(int client_fd)
+{
+    /// \note answered on the daemon's thread, one client after the other: a fork() here would
+    ///       happen while the Executor workers run, and the child could inherit a lock one of
+    ///       them holds (e.g. in malloc) with no thread left to release it
+
+    // a client that neither sends nor reads must not hold up the others forever
+    timeval timeout = {client_timeout_s, 0};
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    string request;
+    char buffer[4096];
+    ssize_t read_size;
+    while((read_size = read(client_fd, buffer, sizeof(buffer))) != 0)
+    {
+        if(read_size < 0 and errno == EINTR)
+            continue;
+        if(read_size < 0)
+        {
+            close(client_fd);
+            return;
+        }
+        request.append(buffer, read_size);
+    }
+
+    vector<string> input;
+    for(size_t start = 0, end ; (end = request.find('\0', start)) != string::npos ; start = end + 1)
+        input.emplace_back(request, start, end - start);
+
+    // whatever the command prints, through cout or stdout, goes to the client
+    cout.flush();
+    fflush(stdout);
+    int daemon_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    dup2(client_fd, STDOUT_FILENO);
+    close(client_fd);
+
+    try
+    {
+        CommandLineInterface cli(db);
+        cli.run(input);
+    }
+    catch(exception &err)
+    {
+        cout << err.what() << endl;
+    }
+
+    cout.flush();
+    fflush(stdout);
+    dup2(daemon_stdout, STDOUT_FILENO);
+    close(daemon_stdout);
+
+    // e.g. the client left before reading everything
+    cout.clear();
+    clearerr(stdout);
+}
@@ -0,0 +1,74 @@
+#include "quantum-resolver/core/atom_table.h"
+#include "quantum-resolver/database.h"
+
+#include <algorithm>
+
+using namespace std;
+
+AtomTable::AtomTable(Database *db) : db(db)
+{
+}
+
+AtomID AtomTable::insert(string_view atom_str)
+{
+    // parsing happens under the lock of the interner shard: a thread looking for the
+    // same atom waits for it instead of finding an ID whose atom is not there yet
+    return atom_strs.insert(atom_str, [this, &atom_str](AtomID atom_id)
+    {
+        atoms.ensure(atom_id) = db->parser.parse_pkg_dependency(atom_str);
+    }).first;
+}
+
+bool AtomTable::is_resolved(const PackageDependency &atom)
+{
+    return atom.pkg_constraint.pkg_id != Repo::npos and
+            ranges::none_of(atom.use_dependencies, [](const UseflagDependency &use_dep){
+                return use_dep.flag_id == UseFlags::npos;
+            });
+}
+
+size_t AtomTable::reparse_unresolved_atoms()
+{
+    size_t changed_atoms = 0;
+    for(AtomID atom_id = 0 ; atom_id < size() ; atom_id++)
+    {
+        if(is_resolved(atoms[atom_id]))
+            continue;
+
+        PackageDependency atom = db->parser.parse_pkg_dependency(atom_strs.name(atom_id));
+        if(is_resolved(atom))
+            changed_atoms++;
+        atoms[atom_id] = std::move(atom);
+    }
+
+    return changed_atoms;
+}
+
+void AtomTable::serialize(BinaryWriter &writer) const
+{
+    writer.write(atom_strs);
+    for(AtomID atom_id = 0 ; atom_id < size() ; atom_id++)
+        writer.write(atoms[atom_id]);
+}
+
+void AtomTable::deserialize(BinaryReader &reader)
+{
+    atoms.clear();
+    reader.read(atom_strs);
+    for(AtomID atom_id = 0 ; atom_id < size() ; atom_id++)
+        reader.read(atoms.ensure(atom_id));
+}
+
+void AtomTable::check_ids() const
+{
+    for(AtomID atom_id = 0 ; atom_id < size() ; atom_id++)
+    {
+        const PackageDependency &atom = atoms[atom_id];
+        if(atom.pkg_constraint.pkg_id != Repo::npos and atom.pkg_constraint.pkg_id >= db->repo.size())
+            throw runtime_error("Atom naming an unknown package");
+
+        for(const UseflagDependency &use_dep: atom.use_dependencies)
+            if(use_dep.flag_id != UseFlags::npos and use_dep.flag_id >= db->useflags.flags_count())
+                throw runtime_error("Atom naming an unknown flag");
+    }
+}
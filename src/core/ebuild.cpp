@@ -11,6 +11,8 @@
 #define FMT_HEADER_ONLY
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <array>
 #include <filesystem>
 
 using namespace std;
@@ -22,21 +24,68 @@ const std::unordered_map<std::string, DependencyType> Ebuild::dependency_types =
     {"BDEPEND", DependencyType::BUILD},
     {"IDEPEND", DependencyType::BUILD},
     {"DEPEND", DependencyType::BUILD},
-    {"RDEPEND", DependencyType::BUILD},
+    {"RDEPEND", DependencyType::RUNTIME},
     {"PDEPEND", DependencyType::RUNTIME},
 };
 // DependencyType::RUNTIME here means its intuitive definition from the resolver point of view:
-// "needed so the package can run", but not needed before (during the emerge).
+// "needed so the package can run", whether or not it gets built, installed ones included.
 // DependencyType::BUILD: needed before starting anything on the ebuild
 
 const std::vector<std::string> Ebuild::metadata_vars = {"BDEPEND", "IDEPEND", "DEPEND", "RDEPEND", "PDEPEND", "IUSE", "SLOT", "KEYWORDS"};
 // "USE" is only used when considering an installed ebuild
 
-Ebuild::Ebuild(string ver,
-               Database *db):
-    eversion(std::move(ver)), db(db)
+const std::vector<std::string> Ebuild::cache_stamp_vars = {"_md5_", "_eclasses_"};
+// only in md5-cache entries, they change whenever the ebuild or one of its eclasses does
+
+static bool references_unknown_packages(const Dependencies &deps, const AtomTable &atoms)
+{
+    /// \brief true if an atom in 'deps' names a package that is not in the repository (yet)
+
+    return ranges::any_of(deps.nodes, [&atoms](const DependencyNode &node){
+        return node.type == DependencyNode::Type::PACKAGE and
+                atoms[node.payload].pkg_constraint.pkg_id == Ebuild::npos;
+    });
+}
+
+static bool is_valid_tree(const Dependencies &deps, size_t atoms_count, size_t flags_count)
+{
+    /// \brief true if the subtrees of 'deps' nest as described by Dependencies, with known atoms and flags
+
+    const auto &nodes = deps.nodes;
+    if(not nodes.empty() and (nodes[0].type != DependencyNode::Type::ALL_OF or nodes[0].end != nodes.size()))
+        return false;
+
+    for(size_t i = 0 ; i < nodes.size() ; i++)
+    {
+        const DependencyNode &node = nodes[i];
+        if(node.end <= i or node.end > nodes.size())
+            return false;
+
+        if(node.type == DependencyNode::Type::PACKAGE)
+        {
+            if(node.end != i + 1 or node.payload >= atoms_count)
+                return false;
+            continue;
+        }
+
+        if(node.type == DependencyNode::Type::USE_CONDITION and node.payload >= flags_count)
+            return false;
+
+        // the children have to end exactly where their group does
+        size_t child = i + 1;
+        while(child < node.end)
+            child = nodes[child].end;
+        if(child != node.end)
+            return false;
+    }
+
+    return true;
+}
+
+Ebuild::Ebuild(Database *db, EbuildColumns *columns, size_t id):
+    db(db), columns(columns), id(id)
 {
-    if(eversion.is_live())
+    if(get_version().is_live())
         keywords.everything_else = Keywords::State::LIVE;
 }
 
@@ -53,30 +102,50 @@ void Ebuild::set_install_path(std::filesystem::path path)
     /// Path of the folder containing metadata about the installed ebuild
     /// in /var/db/pkg
 
-    installed = true;
+    fs::path use_file = path / "USE";
+    string use_file_contents;
+    if(fs::is_regular_file(use_file))
+    {
+        read_file_contents(use_file, use_file_contents);
+        set_install_path(std::move(path), use_file_contents);
+    }
+    else set_install_path(std::move(path), nullopt);
+}
+
+void Ebuild::set_install_path(std::filesystem::path path, optional<string_view> use_file_contents)
+{
+    columns->set(id, EbuildColumns::INSTALLED, true);
     install_path = std::move(path);
+    finalized_flag_states = false;
 
-    load_install_time_active_flags();
+    install_time_active_flags.clear();
+    if(use_file_contents)
+        load_install_time_active_flags(*use_file_contents);
 }
 
-void Ebuild::load_install_time_active_flags()
+void Ebuild::set_uninstalled()
 {
-    fs::path use_file = install_path.string() + "/USE";
-    if(fs::is_regular_file(use_file))
-    {
-        auto file_lines = read_file_lines(use_file);
-        if(file_lines.size() != 1)
-            throw runtime_error(fmt::format("{} should have only one line of text", use_file.string()));
+    columns->set(id, EbuildColumns::INSTALLED, false);
+    changed_use = false;
+    finalized_flag_states = false;
+    install_path.clear();
+    install_time_active_flags.clear();
+}
 
-        auto flag_states = db->parser.parse_useflags(file_lines[0], true, true);
+void Ebuild::load_install_time_active_flags(string_view use_file_contents)
+{
+    auto file_lines = get_lines(use_file_contents);
+    if(file_lines.size() != 1)
+        throw runtime_error(fmt::format("{} should have only one line of text", (install_path / "USE").string()));
 
-        for(auto [flagID, state]: flag_states)
-        {
-            if(not state)
-                throw runtime_error("-flag found in USE file for installed package");
+    auto flag_states = db->parser.parse_useflags(file_lines[0], true, true);
 
-            install_time_active_flags.insert(flagID);
-        }
+    for(auto [flagID, state]: flag_states)
+    {
+        if(not state)
+            throw runtime_error("-flag found in USE file for installed package");
+
+        install_time_active_flags.insert(flag_index->insert(flagID));
     }
 }
 
@@ -86,13 +155,22 @@ void Ebuild::parse_deps()
         return;
 
     if(ebuild_data.empty())
-        ebuild_data = read_unquoted_vars(ebuild_path, metadata_vars);
+        load_data();
 
+    complete_deps = true;
     for(const auto& [dep_str, dep_type]: dependency_types)
         if(ebuild_data.contains(dep_str))
-            add_deps(parse_dep_string(ebuild_data[dep_str]), dep_type);
+        {
+            Dependencies deps = parse_dep_string(ebuild_data[dep_str]);
+            complete_deps = complete_deps and deps.valid and not references_unknown_packages(deps, db->atoms);
+            add_deps(std::move(deps), dep_type);
+        }
+
+    bdeps.nodes.shrink_to_fit();
+    rdeps.nodes.shrink_to_fit();
 
     parsed_deps = true;
+    release_data();
 }
 
 void Ebuild::parse_metadata()
@@ -107,46 +185,131 @@ void Ebuild::parse_metadata()
     {
         auto flag_states = db->parser.parse_useflags(ebuild_data["IUSE"], false, true);
         add_iuse_flags(flag_states);
-
-        // Define iuse_effective and retrieve initial state of flags from global state
-        // the state then will be changed with assign_use_flag_state() calls from Repository
-        // because Repository will read package useflag custom settings
-        iuse_effective = (db->useflags.get_implicit_flags() + iuse);
-        use += (db->useflags.get_use() & iuse_effective); // + use is to keep the default states from IUSE, e.g. +flag -flag2
-        use_force = db->useflags.get_use_force() & iuse_effective;
-        use_mask = db->useflags.get_use_mask() & iuse_effective;
-
-        auto use_mask_strs = db->useflags.to_flag_names(use_mask);
     }
 
     if(ebuild_data.contains("SLOT"))
     {
-        size_t subslot_sep_index = ebuild_data["SLOT"].find_first_of("/");
+        string_view slot_str = ebuild_data["SLOT"];
+        size_t subslot_sep_index = slot_str.find_first_of("/");
         if(subslot_sep_index == string::npos)
-        {
-            slot = ebuild_data["SLOT"];
-            subslot = ebuild_data["SLOT"];
-        }
+            columns->slot_ids[id] = columns->subslot_ids[id] = slot_index->insert(slot_str);
         else
         {
-            slot = ebuild_data["SLOT"].substr(0, subslot_sep_index);
-            subslot = ebuild_data["SLOT"].substr(subslot_sep_index+1);
+            columns->slot_ids[id] = slot_index->insert(slot_str.substr(0, subslot_sep_index));
+            columns->subslot_ids[id] = slot_index->insert(slot_str.substr(subslot_sep_index+1));
         }
     }
 
     if(ebuild_data.contains("KEYWORDS"))
-    {
         keywords = db->parser.parse_keywords(ebuild_data["KEYWORDS"], Parser::KeywordType::KEYWORDS);
-        accept_keywords(db->useflags.get_accepted_keywords());
+
+    parsed_metadata = true;
+
+    reset_flag_states();
+    release_data();
+}
+
+void Ebuild::release_data()
+{
+    /// \brief frees the raw metadata once both parses are done, it is read again
+    ///        from disk if the ebuild ever needs to be parsed again
+
+    if(parsed_metadata and parsed_deps)
+        ebuild_data.clear();
+}
+
+void Ebuild::reset_flag_states()
+{
+    /// \brief puts the flag states and the keyword acceptance back to what the
+    ///        global profile settings give, before any per package setting
+
+    if(not parsed_metadata)
+    {
+        // parse_metadata() calls back this function once done
+        parse_metadata();
+        return;
     }
 
+    // Define iuse_effective and retrieve initial state of flags from global state
+    // the state then will be changed with assign_use_flag_state() calls from Repository
+    // because Repository will read package useflag custom settings
+    iuse_effective = iuse;
+    for(FlagID flag_id: db->useflags.get_implicit_flags())
+        iuse_effective.insert(flag_index->insert(flag_id));
+
+    use = iuse_defaults + flag_index->select(iuse_effective, db->useflags.get_use()); // keep the default states from IUSE, e.g. +flag -flag2
+    use_force = flag_index->select(iuse_effective, db->useflags.get_use_force());
+    use_mask = flag_index->select(iuse_effective, db->useflags.get_use_mask());
+
     if(keywords.get_keyword(db->useflags.get_arch_id()) == Keywords::State::STABLE)
     {
-        use_force += db->useflags.get_use_stable_force() & iuse_effective;
-        use_mask += db->useflags.get_use_stable_mask() & iuse_effective;
+        use_force += flag_index->select(iuse_effective, db->useflags.get_use_stable_force());
+        use_mask += flag_index->select(iuse_effective, db->useflags.get_use_stable_mask());
     }
 
-    parsed_metadata = true;
+    accept_keywords(db->useflags.get_accepted_keywords());
+
+    finalized_flag_states = false;
+}
+
+void Ebuild::reload_metadata()
+{
+    /// \brief forgets everything that has been parsed from the metadata and parses it again
+    /// \note  the installed state is kept, per package settings need to be applied again
+
+    ebuild_data.clear();
+
+    keywords = Keywords();
+    if(get_version().is_live())
+        keywords.everything_else = Keywords::State::LIVE;
+
+    iuse.clear();
+    iuse_defaults.clear();
+    columns->slot_ids[id] = columns->subslot_ids[id] = SlotIndex::npos;
+
+    parsed_metadata = false;
+
+    parse_metadata();
+    reparse_deps();
+}
+
+void Ebuild::reparse_deps()
+{
+    /// \brief parses the dependency strings again, e.g. once the packages they refer to are known
+
+    bdeps = Dependencies();
+    rdeps = Dependencies();
+    parsed_deps = complete_deps = false;
+
+    parse_deps();
+}
+
+bool Ebuild::cache_entry_changed()
+{
+    /// \brief tells if the md5-cache entry differs from the one that has been parsed
+    /// \note  a new modification time alone is not enough, as syncing can rewrite
+    ///        identical entries: _md5_ and _eclasses_ are compared in that case
+
+    if(ebuild_path.empty())
+        return false;
+
+    error_code ec;
+    auto mtime = fs::last_write_time(ebuild_path, ec).time_since_epoch().count();
+    auto size = ec ? 0 : fs::file_size(ebuild_path, ec);
+    if(ec)
+        return true;
+
+    if(mtime == cache_stamp.mtime and size == cache_stamp.size)
+        return false;
+
+    RawVars stamp_data(ebuild_path, cache_stamp_vars);
+    if(stamp_data["_md5_"] != cache_stamp.md5 or
+            hash<string_view>{}(stamp_data["_eclasses_"]) != cache_stamp.eclasses_hash)
+        return true;
+
+    cache_stamp.mtime = mtime;
+    cache_stamp.size = size;
+    return false;
 }
 
 void Ebuild::finalize_flag_states()
@@ -155,9 +318,44 @@ void Ebuild::finalize_flag_states()
         parse_metadata();
 
     finalized_flag_states = true;
+    active_flags = use + use_force - use_mask;
 
-    if(installed)
-        changed_use = (get_active_flags() != install_time_active_flags);
+    if(is_installed())
+        changed_use = (active_flags != install_time_active_flags);
+}
+
+CacheEntry Ebuild::read_cache_entry(const fs::path &entry_path, string_view contents)
+{
+    static const vector<string> cache_entry_vars = [](){
+        vector<string> vars = metadata_vars;
+        vars.insert(vars.end(), cache_stamp_vars.begin(), cache_stamp_vars.end());
+        return vars;
+    }();
+
+    CacheEntry entry;
+    entry.vars = RawVars(contents, cache_entry_vars);
+
+    if(entry.vars.contains("USE"))
+        throw runtime_error("USE line in ebuild, should not exist");
+
+    error_code ec;
+    entry.stamp.mtime = fs::last_write_time(entry_path, ec).time_since_epoch().count();
+    entry.stamp.size = ec ? 0 : fs::file_size(entry_path, ec);
+    entry.stamp.md5 = entry.vars["_md5_"];
+    entry.stamp.eclasses_hash = hash<string_view>{}(entry.vars["_eclasses_"]);
+
+    return entry;
+}
+
+void Ebuild::set_cache_entry(string_view contents)
+{
+    set_cache_entry(read_cache_entry(ebuild_path, contents));
+}
+
+void Ebuild::set_cache_entry(CacheEntry entry)
+{
+    ebuild_data = std::move(entry.vars);
+    cache_stamp = std::move(entry.stamp);
 }
 
 void Ebuild::load_data()
@@ -169,10 +367,9 @@ void Ebuild::load_data()
     if(not ebuild_path.empty())
     {
         // Prefer ebuild_path over install path to get data
-        ebuild_data = read_unquoted_vars(ebuild_path, metadata_vars);
-
-        if(ebuild_data.contains("USE"))
-            throw runtime_error("USE line in ebuild, should not exist");
+        thread_local string contents;
+        read_file_contents(ebuild_path, contents);
+        set_cache_entry(contents);
     }
     else
     {
@@ -189,16 +386,17 @@ void Ebuild::load_data()
             if(file_lines.empty() or file_lines.size() > 1)
                 throw runtime_error("Weird format in metadata of installed package");
 
-            ebuild_data[var_str] = std::move(read_file_lines(var_file)[0]);
+            ebuild_data.add(var_str, file_lines[0]);
         }
     }
 }
 
 void Ebuild::add_iuse_flag(size_t flag_id, bool default_state)
 {
-    iuse.insert(flag_id);
+    LocalFlagIndex::LocalFlagID local_id = flag_index->insert(flag_id);
+    iuse.insert(local_id);
     if(default_state)
-        use.insert(flag_id);
+        iuse_defaults.insert(local_id);
 }
 
 void Ebuild::add_iuse_flags(std::unordered_map<std::size_t, bool> useflags_and_default_states)
@@ -209,7 +407,10 @@ void Ebuild::add_iuse_flags(std::unordered_map<std::size_t, bool> useflags_and_d
 
 void Ebuild::accept_keywords(const Keywords& accept_these_keywords)
 {
-    keyword_accepted = keywords.respects(db->useflags.get_arch_id(), accept_these_keywords);
+    if(not parsed_metadata)
+        parse_metadata();
+
+    columns->set(id, EbuildColumns::KEYWORD_ACCEPTED, keywords.respects(db->useflags.get_arch_id(), accept_these_keywords));
 }
 
 void Ebuild::assign_useflag_state(size_t flag_id, bool state, const FlagAssignType &assign_type)
@@ -217,51 +418,58 @@ void Ebuild::assign_useflag_state(size_t flag_id, bool state, const FlagAssignTy
     if(not parsed_metadata)
         parse_metadata();
 
-    if(not iuse_effective.contains(flag_id))
+    LocalFlagIndex::LocalFlagID local_id = flag_index->find(flag_id);
+    if(local_id == flag_index->npos or not iuse_effective.contains(local_id))
         return;
 
+    // the active flags get computed again
+    finalized_flag_states = false;
+
     if(assign_type == FlagAssignType::DIRECT or
             (assign_type == FlagAssignType::STABLE_DIRECT and keywords.get_keyword(db->useflags.get_arch_id()) == Keywords::State::STABLE))
     {
         if(state)
-            use.insert(flag_id);
-        else use.erase(flag_id);
+            use.insert(local_id);
+        else use.erase(local_id);
     }
     else if(assign_type == FlagAssignType::FORCE or
             (assign_type == FlagAssignType::STABLE_FORCE and keywords.get_keyword(db->useflags.get_arch_id()) == Keywords::State::STABLE))
     {
         if(state)
-            use_force.insert(flag_id);
-        else use_force.erase(flag_id);
+            use_force.insert(local_id);
+        else use_force.erase(local_id);
     }
     else if(assign_type == FlagAssignType::MASK or
             (assign_type == FlagAssignType::STABLE_MASK and keywords.get_keyword(db->useflags.get_arch_id()) == Keywords::State::STABLE))
     {
         if(state)
-            use_mask.insert(flag_id);
-        else use_mask.erase(flag_id);
+            use_mask.insert(local_id);
+        else use_mask.erase(local_id);
     }
 }
 
 bool Ebuild::has_changed_use()
 {
+    if(not finalized_flag_states)
+        finalize_flag_states();
+
     return changed_use;
 }
 
 bool Ebuild::is_installed() const
 {
-    return installed;
+    return columns->has(id, EbuildColumns::INSTALLED);
 }
 
-std::unordered_set<FlagID> Ebuild::get_active_flags()
+const DynamicBitset& Ebuild::get_active_flags()
 {
     if(not finalized_flag_states)
         finalize_flag_states();
 
-    return use + use_force - use_mask;
+    return active_flags;
 }
 
-std::unordered_set<FlagID> Ebuild::get_changed_flags()
+DynamicBitset Ebuild::get_changed_flags()
 {
     /// \brief when package is installed, returns the flags whose state has changed
     ///        with respect to install time ones (will be re-emerged if an update is performed)
@@ -269,24 +477,21 @@ std::unordered_set<FlagID> Ebuild::get_changed_flags()
     if(not finalized_flag_states)
         finalize_flag_states();
 
-    if(installed)
-        return get_active_flags() ^ get_install_active_flags();
-    else return std::unordered_set<FlagID>();
+    if(is_installed())
+        return active_flags ^ install_time_active_flags;
+    else return DynamicBitset();
 }
 
-std::unordered_set<FlagID> Ebuild::get_enforced_flags()
+DynamicBitset Ebuild::get_enforced_flags()
 {
     /// \brief returns the set of flags that are either masked or forced
     if(not finalized_flag_states)
         finalize_flag_states();
 
-    auto use_force_strs = db->useflags.to_flag_names(use_force);
-    auto use_mask_strs = db->useflags.to_flag_names(use_mask);
-
     return use_force + use_mask;
 }
 
-std::unordered_set<FlagID> Ebuild::get_install_active_flags()
+const DynamicBitset& Ebuild::get_install_active_flags()
 {
     if(not finalized_flag_states)
         finalize_flag_states();
@@ -294,7 +499,7 @@ std::unordered_set<FlagID> Ebuild::get_install_active_flags()
     return install_time_active_flags;
 }
 
-const std::unordered_set<FlagID>& Ebuild::get_use()
+const DynamicBitset& Ebuild::get_use()
 {
     if(not finalized_flag_states)
         finalize_flag_states();
@@ -302,7 +507,7 @@ const std::unordered_set<FlagID>& Ebuild::get_use()
     return use;
 }
 
-const std::unordered_set<FlagID>& Ebuild::get_iuse()
+const DynamicBitset& Ebuild::get_iuse()
 {
     if(not parsed_metadata)
         parse_metadata();
@@ -310,7 +515,31 @@ const std::unordered_set<FlagID>& Ebuild::get_iuse()
     return iuse;
 }
 
-const std::unordered_set<FlagID>& Ebuild::get_use_mask()
+const DynamicBitset& Ebuild::get_iuse_effective()
+{
+    if(not parsed_metadata)
+        parse_metadata();
+
+    return iuse_effective;
+}
+
+const Dependencies& Ebuild::get_bdeps()
+{
+    if(not parsed_deps)
+        parse_deps();
+
+    return bdeps;
+}
+
+const Dependencies& Ebuild::get_rdeps()
+{
+    if(not parsed_deps)
+        parse_deps();
+
+    return rdeps;
+}
+
+const DynamicBitset& Ebuild::get_use_mask()
 {
     if(not finalized_flag_states)
         finalize_flag_states();
@@ -318,7 +547,7 @@ const std::unordered_set<FlagID>& Ebuild::get_use_mask()
     return use_mask;
 }
 
-const std::unordered_set<FlagID>& Ebuild::get_use_force()
+const DynamicBitset& Ebuild::get_use_force()
 {
     if(not finalized_flag_states)
         finalize_flag_states();
@@ -328,19 +557,21 @@ const std::unordered_set<FlagID>& Ebuild::get_use_force()
 
 std::string Ebuild::get_slot_str() const
 {
-    if(slot == subslot)
-        return slot;
-    else return slot + "/" + subslot;
+    if(get_slot_id() == get_subslot_id())
+        return get_slot();
+    else return get_slot() + "/" + get_subslot();
 }
 
 const std::string& Ebuild::get_slot() const
 {
-    return slot;
+    static const string no_slot;
+    return get_slot_id() == SlotIndex::npos ? no_slot : slot_index->name(get_slot_id());
 }
 
 const std::string& Ebuild::get_subslot() const
 {
-    return subslot;
+    static const string no_slot;
+    return get_subslot_id() == SlotIndex::npos ? no_slot : slot_index->name(get_subslot_id());
 }
 
 void Ebuild::assign_useflag_states(const UseflagStates &useflag_states, const FlagAssignType &assign_type)
@@ -349,10 +580,64 @@ void Ebuild::assign_useflag_states(const UseflagStates &useflag_states, const Fl
         assign_useflag_state(flag_id, flag_state, assign_type);
 }
 
+void Ebuild::serialize(BinaryWriter &writer) const
+{
+    /// \note the raw ebuild_data is not saved: whatever has not been parsed yet
+    ///       gets read again from the paths when needed
+    /// \note the version, slots and states are in the columns, saved by the package
+
+    writer.write(ebuild_path);
+    writer.write(install_path);
+    writer.write(keywords);
+    writer.write(cache_stamp);
+    writer.write(bdeps);
+    writer.write(rdeps);
+    writer.write(std::tie(iuse, iuse_defaults, iuse_effective, use, use_mask, use_force, active_flags, install_time_active_flags));
+    writer.write(std::tie(id, pkg_id, changed_use));
+    writer.write(std::tie(parsed_metadata, parsed_deps, finalized_flag_states, complete_deps));
+}
+
+void Ebuild::deserialize(BinaryReader &reader)
+{
+    ebuild_data.clear();
+
+    reader.read(ebuild_path);
+    reader.read(install_path);
+    reader.read(keywords);
+    reader.read(cache_stamp);
+    reader.read(bdeps);
+    reader.read(rdeps);
+
+    auto flag_sets = std::tie(iuse, iuse_defaults, iuse_effective, use, use_mask, use_force, active_flags, install_time_active_flags);
+    reader.read(flag_sets);
+
+    auto ids_and_install_state = std::tie(id, pkg_id, changed_use);
+    reader.read(ids_and_install_state);
+
+    auto parse_state = std::tie(parsed_metadata, parsed_deps, finalized_flag_states, complete_deps);
+    reader.read(parse_state);
+}
+
+void Ebuild::check_ids() const
+{
+    for(const DynamicBitset *flags: {&iuse, &iuse_defaults, &iuse_effective, &use, &use_mask, &use_force,
+                                     &active_flags, &install_time_active_flags})
+        if(flags->bound() > flag_index->size())
+            throw runtime_error("Flag set naming an unknown flag");
+
+    for(const auto &[arch, state]: keywords.explicitely_defined)
+        if(arch >= db->useflags.flags_count())
+            throw runtime_error("Keyword naming an unknown arch");
+
+    for(const Dependencies *deps: {&bdeps, &rdeps})
+        if(not is_valid_tree(*deps, db->atoms.size(), db->useflags.flags_count()))
+            throw runtime_error("Invalid dependency tree");
+}
+
 bool Ebuild::operator <(const Ebuild &other)
 {
     assert(pkg_id == other.pkg_id); // Make sure we are comparing ebuilds of the same package
-    return eversion < other.eversion;
+    return get_version() < other.get_version();
 }
 
 Keywords::State Ebuild::get_arch_keyword() const
@@ -362,68 +647,80 @@ Keywords::State Ebuild::get_arch_keyword() const
 
 void Ebuild::add_deps(Dependencies deps, DependencyType dep_type)
 {
-    Dependencies &m_deps = dep_type == DependencyType::BUILD ? bdeps : rdeps;
+    /// \brief appends the top level dependencies of 'deps' to the root group of the ones of 'dep_type'
 
-    // or_deps
-    std::move(deps.or_deps.begin(), deps.or_deps.end(), std::back_inserter(m_deps.or_deps));
+    Dependencies &m_deps = dep_type == DependencyType::BUILD ? bdeps : rdeps;
 
-    // plain_deps
-    std::move(deps.plain_deps.begin(), deps.plain_deps.end(), std::back_inserter(m_deps.plain_deps));
+    if(deps.empty())
+        return;
 
-    // use_cond_deps
-    std::move(deps.use_cond_deps.begin(), deps.use_cond_deps.end(), std::back_inserter(m_deps.use_cond_deps));
+    if(m_deps.empty())
+    {
+        m_deps = std::move(deps);
+        return;
+    }
 
-    //xor_deps
-    std::move(deps.xor_deps.begin(), deps.xor_deps.end(), std::back_inserter(m_deps.xor_deps));
+    // the root of 'deps' is dropped, its children go after the ones of m_deps
+    const uint32_t node_offset = m_deps.nodes.size() - 1;
+    for(size_t i = 1 ; i < deps.nodes.size() ; i++)
+    {
+        DependencyNode node = deps.nodes[i];
+        node.end += node_offset;
+        m_deps.nodes.push_back(node);
+    }
+    m_deps.nodes.front().end = m_deps.nodes.size();
 }
 
 Dependencies Ebuild::parse_dep_string(string_view dep_string)
 {
     /* Receives a dependency string as formatted in files in /var/db/repos/gentoo/metadata/md5-cache/
      * e.g. || ( dev-lang/python:3.10[ncurses,sqlite,ssl] dev-lang/python:3.9[ncurses,sqlite,ssl] dev-lang/python:3.8[ncurses,sqlite,ssl] ) app-arch/unzip
+     * the returned tree has no nodes if the string cannot be parsed, e.g. it names an unknown flag
      */
 
     Dependencies deps;
+    deps.valid = parse_dep_group(dep_string, {DependencyNode::Type::ALL_OF}, deps);
+    if(not deps.valid)
+        return Dependencies();
 
-    vector<tuple<string, std::vector<Dependencies>&>> pkg_group_dep_map
-    {
-        {"|| (", deps.or_deps},
-        {"^^ (", deps.xor_deps},
-        {"?? (", deps.at_most_one_deps},
-        {"(", deps.all_of_deps}
-    };
+    return deps;
+}
+
+bool Ebuild::parse_dep_group(string_view dep_string, DependencyNode group, Dependencies &deps)
+{
+    /// \brief appends 'group' to deps.nodes, followed by the nodes of its content 'dep_string'
+    /// \return false if the content cannot be parsed
+
+    static const array<pair<string_view, DependencyNode::Type>, 4> group_types =
+    {{
+        {"|| (", DependencyNode::Type::ANY_OF},
+        {"^^ (", DependencyNode::Type::EXACTLY_ONE_OF},
+        {"?? (", DependencyNode::Type::AT_MOST_ONE_OF},
+        {"(", DependencyNode::Type::ALL_OF}
+    }};
+
+    const size_t group_index = deps.nodes.size();
+    deps.nodes.push_back(group);
 
     skim_spaces_at_the_edges(dep_string);
 
     while(not dep_string.empty())
     {
-        bool found_pkg_group;
-        do
+        auto group_type = ranges::find_if(group_types, [&dep_string](const auto& group_type){ return dep_string.starts_with(group_type.first); });
+        if(group_type != group_types.end())
         {
-            found_pkg_group = false;
-            for(auto& [pkg_group_string, container]: pkg_group_dep_map)
-            {
-                if(dep_string.starts_with(pkg_group_string))
-                {
-                    dep_string.remove_prefix(pkg_group_string.size() - 1);
-
-                    const string_view &enclosed_string = get_pth_enclosed_string_view(dep_string);
-                    Dependencies&& deps = parse_dep_string(enclosed_string);
-                    if(not deps.valid)
-                        return deps;
-
-                    container.emplace_back(std::move(deps));
+            // keep the opening parenthesis
+            dep_string.remove_prefix(group_type->first.size() - 1);
 
-                    // move prefix to skip the enclosed content +2 to remove the parentheses
-                    dep_string.remove_prefix(enclosed_string.size() + 2);
-
-                    // so always the first character is not a space
-                    skim_spaces_at_the_edges(dep_string);
+            const string_view enclosed_string = get_pth_enclosed_string_view(dep_string);
+            if(not parse_dep_group(enclosed_string, {group_type->second}, deps))
+                return false;
 
-                    found_pkg_group = true;
-                }
-            }
-        }while(found_pkg_group);
+            // move prefix to skip the enclosed content +2 to remove the parentheses
+            dep_string.remove_prefix(enclosed_string.size() + 2);
+            skim_spaces_at_the_edges(dep_string);
+            continue;
+        }
 
         // it's okay if it returns npos
         size_t count = dep_string.find_first_of(' ');
@@ -447,17 +744,14 @@ Dependencies Ebuild::parse_dep_string(string_view dep_string)
 
             FlagID flag_id = db->useflags.get_flag_id(constraint);
             if(flag_id == db->useflags.npos)
-                return deps;
-
-            // retrieve the enclosed content and add it to use_cond_deps
+                return false;
 
+            // the enclosed content goes under the condition
             skim_spaces_at_the_edges(dep_string);
             const string_view enclosed_string = get_pth_enclosed_string_view(dep_string);
-            Dependencies&& use_cond_deps = parse_dep_string(enclosed_string);
-            if(not use_cond_deps.valid)
-                return deps;
-
-            deps.use_cond_deps.emplace_back(flag_id, flag_state, std::move(use_cond_deps));
+            DependencyNode use_condition = {DependencyNode::Type::USE_CONDITION, flag_state, 0, uint32_t(flag_id)};
+            if(not parse_dep_group(enclosed_string, use_condition, deps))
+                return false;
 
             // move prefix to skip the enclosed content +2 to remove the parentheses
             dep_string.remove_prefix(enclosed_string.size() + 2);
@@ -465,14 +759,15 @@ Dependencies Ebuild::parse_dep_string(string_view dep_string)
         else
         {
             // it is a "plain" (this may be a nested call) pkg constraint
-            deps.plain_deps.push_back(db->parser.parse_pkg_dependency(constraint));
+            AtomID atom_id = db->atoms.insert(constraint);
+            deps.nodes.push_back({DependencyNode::Type::PACKAGE, true, uint32_t(deps.nodes.size() + 1), uint32_t(atom_id)});
         }
 
         skim_spaces_at_the_edges(dep_string);
     }
 
-    deps.valid = true;
-    return deps;
+    deps.nodes[group_index].end = deps.nodes.size();
+    return true;
 }
 
 FlagState Ebuild::get_flag_state(const size_t &flag_id)
@@ -481,17 +776,18 @@ FlagState Ebuild::get_flag_state(const size_t &flag_id)
         finalize_flag_states();
 
     FlagState state = FlagState::NOT_IN_IUSE_EFFECTIVE;
-    if(not iuse_effective.contains(flag_id))
+    LocalFlagIndex::LocalFlagID local_id = flag_index->find(flag_id);
+    if(local_id == flag_index->npos or not iuse_effective.contains(local_id))
         return state;
 
-    if(use_force.contains(flag_id))
+    if(use_force.contains(local_id))
         state = FlagState::FORCED;
-    if(use_mask.contains(flag_id))
+    if(use_mask.contains(local_id))
         state = FlagState::MASKED;
 
     if(state == FlagState::NOT_IN_IUSE_EFFECTIVE)
     {
-        state = use.contains(flag_id) ? FlagState::ON : FlagState::OFF;
+        state = use.contains(local_id) ? FlagState::ON : FlagState::OFF;
     }
 
     return state;
@@ -502,36 +798,49 @@ bool Ebuild::respects_usestates(const UseDependencies &use_dependencies)
     if(not parsed_deps)
         parse_deps();
 
+    // the flags that have to be on and off, checked against the active ones all at once
+    DynamicBitset required_on, required_off;
+
     for(const UseflagDependency &use_dep: use_dependencies)
     {
         if(use_dep.type == UseflagDependency::Type::CONDITIONAL)
             throw runtime_error("Testing against conditional use dependencies, only direct is allowed");
 
-        if(not iuse_effective.contains(use_dep.flag_id))
+        LocalFlagIndex::LocalFlagID local_id = flag_index->find(use_dep.flag_id);
+        if(local_id == flag_index->npos or not iuse_effective.contains(local_id))
         {
-            if(use_dep.direct_dep.has_default_if_unexisting and use_dep.direct_dep.state != use_dep.direct_dep.default_if_unexisting)
-                return false;
+            if(use_dep.direct_dep.has_default_if_unexisting)
+            {
+                if(use_dep.direct_dep.state != use_dep.direct_dep.default_if_unexisting)
+                    return false;
+            }
             else throw runtime_error("In: " + db->repo.get_pkg_groupname(pkg_id) + "  id: " + to_string(id) + "\n" +
                                      "      Asking for useflag: " + db->useflags.get_flag_name(use_dep.flag_id) + " state but "
                                      " it has not been set and doesn't a fallback default");
         }
-        else if(get_active_flags().contains(use_dep.flag_id) != use_dep.direct_dep.state)
-            return false;
+        else if(use_dep.direct_dep.state)
+            required_on.insert(local_id);
+        else required_off.insert(local_id);
     }
 
-    return true;
+    const DynamicBitset &active = get_active_flags();
+    return required_on.is_subset_of(active) and not required_off.intersects(active);
 }
 
 bool Ebuild::respects_pkg_constraint(const PackageConstraint &pkg_constraint)
 {
-    return (pkg_constraint.slot.slot_str.empty() or pkg_constraint.slot.slot_str == slot) and
-                  (pkg_constraint.slot.subslot_str.empty() or pkg_constraint.slot.subslot_str == subslot) and
-                  eversion.respects_constraint(pkg_constraint.ver);
+    return respects_slot_constraint(pkg_constraint.slot) and get_version().respects_constraint(pkg_constraint.ver);
+}
+
+bool Ebuild::respects_slot_constraint(const SlotConstraint &slot_constraint)
+{
+    return (slot_constraint.slot_str.empty() or slot_constraint.slot_str == get_slot()) and
+                  (slot_constraint.subslot_str.empty() or slot_constraint.subslot_str == get_subslot());
 }
 
 bool Ebuild::respects_pkg_dep(const PackageDependency &pkg_dep)
 {
-    if(masked)
+    if(is_masked())
         return false;
 
     bool result = respects_pkg_constraint(pkg_dep.pkg_constraint) and respects_usestates(pkg_dep.use_dependencies);
@@ -1,37 +1,21 @@
-#include <locale>
 #include <algorithm>
-#include <iostream>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
 #include <ranges>
 #include <string>
 
 #include "quantum-resolver/core/ebuild_version.h"
-#include "quantum-resolver/utils/string_utils.h"
 
-template<class Object>
-std::size_t index_of(const std::vector<Object> vec, Object obj)
-{
-    // Get the index of obj in vec
-    return std::size_t(find(vec.cbegin(), vec.cend(), obj) - vec.cbegin());
-}
-
-// The regex that validates EBUILD version strings
-const std::regex EbuildVersion::ver_regexp = std::regex("^(\\d+)((\\.\\d+)*)([a-z]?)((_(pre|p|beta|alpha|rc)\\d*)*)(-r(\\d+))?$");
-
-// All the separators in an EBUILD string
-const std::vector<std::string> EbuildVersion::ordered_separators = {"-r", "_alpha", "_beta", "_pre", "_rc", "_p", "."};
-
-// Index of "." in ordered_separators
-const std::size_t EbuildVersion::dot_index = index_of(EbuildVersion::ordered_separators, std::string("."));
+// Token types of the version keys. When two versions start the same way, what comes next in each
+// decides which one is the newest, in this order (PMS):
+// 1.0_alpha < 1.0_beta < 1.0_pre < 1.0_rc < 1.0 < 1.0-r1 < 1.0_p1 < 1.0a < 1.0.01 < 1.0.1
+// ZERO_COMPONENT is a component after the first one that starts with a 0, which PMS compares as a string
+enum KeyToken : unsigned char {ALPHA = 1, BETA, PRE, RC, END, REVISION, PATCH, LETTER, ZERO_COMPONENT, COMPONENT};
 
-
-inline bool is_smaller_than_nothing(const std::size_t sep_index)
-{
-    // if sep_index refers to "_rc", "_pre", "_beta" or "_alpha", return true.
-    // If an ebuild has a version string v, then v' = v + (any of the separators above) + (whatever else) makes the version v' smaller
-    // Example "1.0_alpha" < "1.0", "1.0_rc3234" < "1.0"
-
-    return 1 <= sep_index and sep_index <= 4;
-}
+// low half of the header of a number that doesn't fit in 8 bytes, see EbuildVersion::append_key_token()
+constexpr unsigned char long_number = 0xF;
 
 EbuildVersion::EbuildVersion() : live(false)
 {
@@ -42,7 +26,7 @@ EbuildVersion::EbuildVersion(std::string ver) : live(false)
     set_version(std::move(ver));
 }
 
-bool EbuildVersion::respects_constraint(const VersionConstraint &constraint)
+bool EbuildVersion::respects_constraint(const VersionConstraint &constraint) const
 {
     switch (constraint.type) {
     case VersionConstraint::Type::NONE:
@@ -74,184 +58,268 @@ bool EbuildVersion::respects_constraint(const VersionConstraint &constraint)
     throw std::runtime_error("Version constraint check failed.");
 }
 
+int EbuildVersion::position_from(const VersionConstraint &constraint) const
+{
+    // every constraint matches a range of the version order that holds its own version,
+    // e.g. =1.2* matches from 1.2_alpha to the last 1.2.x, so what doesn't match
+    // is on the same side of the range as it is of that version
+    if(respects_constraint(constraint))
+        return 0;
+
+    // only > and < leave out their own version, which comes before the range of >
+    const int res = compare(*this, constraint.version);
+    if(res == 0)
+        return constraint.type == VersionConstraint::Type::SGREATER ? -1 : 1;
+
+    return res < 0 ? -1 : 1;
+}
+
 const std::string &EbuildVersion::string() const
 {
     return version;
 }
 
-bool EbuildVersion::is_live()
+bool EbuildVersion::is_live() const
 {
     return live;
 }
 
-void EbuildVersion::update_live_bool(const std::vector<std::pair<std::size_t, std::string_view>>& split)
+void EbuildVersion::serialize(BinaryWriter &writer) const
+{
+    writer.write(version);
+    writer.write(key);
+    writer.write(std::tie(key_size, revisionless_key_size, live));
+}
+
+void EbuildVersion::deserialize(BinaryReader &reader)
+{
+    reader.read(version);
+    reader.read(key);
+
+    auto key_info = std::tie(key_size, revisionless_key_size, live);
+    reader.read(key_info);
+
+    if(key_size > key.size() or revisionless_key_size > key_size)
+        throw std::runtime_error("Invalid version key size");
+}
+
+void EbuildVersion::append_key_token(unsigned char token_type, unsigned long number)
+{
+    /// \brief appends a header byte, made of the token type and of the number of bytes that
+    ///        'number' needs, followed by these bytes, most significant first
+    /// \note  a number that needs more bytes is bigger: comparing the headers first is right
+
+    const unsigned char number_bytes = (std::bit_width(number) + 7) / 8;
+    if(std::size_t(key_size) + 1 + number_bytes > key.size())
+        throw std::runtime_error("Version string with too many parts");
+
+    key[key_size++] = (token_type << 4) | number_bytes;
+    for(int i = number_bytes - 1 ; i >= 0 ; i--)
+        key[key_size++] = (number >> (8 * i)) & 0xFF;
+}
+
+void EbuildVersion::append_key_token(unsigned char token_type, std::string_view digits)
+{
+    /// \brief same with the number written by 'digits', which can be of any length (PMS sets no limit)
+    /// \note  a number that doesn't fit in 8 bytes gets the biggest header, then its number of digits
+    ///        and its digits: it is bigger than the others, and compares right with its likes
+
+    digits.remove_prefix(std::min(digits.find_first_not_of('0'), digits.size()));
+
+    unsigned long number = 0;
+    if(std::from_chars(digits.data(), digits.data() + digits.size(), number).ec != std::errc::result_out_of_range)
+    {
+        append_key_token(token_type, number);
+        return;
+    }
+
+    if(std::size_t(key_size) + 2 + digits.size() > key.size())
+        throw std::runtime_error("Version string with too many parts");
+
+    key[key_size++] = (token_type << 4) | long_number;
+    key[key_size++] = digits.size();
+    for(char digit: digits)
+        key[key_size++] = digit;
+}
+
+void EbuildVersion::append_zero_component(std::string_view digits)
 {
-    /// Update the bool 'live' that says if this version is a live version
-    auto res = std::ranges::find_if(split.rbegin(), split.rend(), [](const auto& pair){return pair.first == dot_index;});
-    live = res != split.rend() and res->second.starts_with("9999");
+    /// \brief appends a component that starts with a 0, besides the first one: PMS compares it as a
+    ///        string once its trailing zeros are removed, e.g. 1.01 < 1.1 and 1.01 == 1.010.
+    ///        Its digits follow the header, then a zero byte
+    /// \note  such a component is always smaller than one that doesn't start with a 0, hence its own
+    ///        token type, and the zero byte that ends it is smaller than any digit of a longer one
+
+    digits.remove_suffix(digits.size() - (digits.find_last_not_of('0') + 1));
+    if(std::size_t(key_size) + 2 + digits.size() > key.size())
+        throw std::runtime_error("Version string with too many parts");
+
+    key[key_size++] = ZERO_COMPONENT << 4;
+    for(char digit: digits)
+        key[key_size++] = digit;
+    key[key_size++] = 0;
 }
 
 void EbuildVersion::set_version(std::string ver)
 {
+    /// \brief encodes 'ver' into 'key': one token per numeric component, letter and suffix, then the
+    ///        revision and an end marker, e.g. 1.2b_rc3-r1 -> [COMPONENT 1][COMPONENT 2][LETTER b][RC 3][REVISION 1][END]
+    /// \note  the numbers are compared as integers, whatever their length, except for the components
+    ///        after the first one that start with a 0, compared as strings as PMS says, e.g. 1.01 < 1.1.
+    ///        -r0 is the same as no revision
+
+    key_size = revisionless_key_size = 0;
+    live = false;
+
     if(ver.empty())
     {
         version.clear();
-        version_parsing.clear();
         return;
     }
 
-    if(not regex_match(ver, ver_regexp))
-        throw std::runtime_error("Version string of invalid format : " + ver);
+    // the string is validated while it gets read, following the grammar
+    // \d+(\.\d+)*[a-z]?(_(alpha|beta|pre|rc|p)\d*)*(-r\d+)?
+    auto invalid_format = [&ver]()
+    {
+        return std::runtime_error("Version string of invalid format : " + ver);
+    };
 
-    std::vector<std::pair<std::size_t, std::string_view>> split = split_string(ver, ordered_separators, dot_index);
+    std::string_view rest(ver);
+    auto read_digits = [&rest, &invalid_format](bool can_be_empty)
+    {
+        // an empty number is a zero, e.g. 1.0_p
+        const std::size_t digits_num = std::min(rest.find_first_not_of("0123456789"), rest.size());
+        if(digits_num == 0 and not can_be_empty)
+            throw invalid_format();
+
+        std::string_view digits = rest.substr(0, digits_num);
+        rest.remove_prefix(digits_num);
+        return digits;
+    };
+
+    // the last numeric component tells if the ebuild is a live one, e.g. 9999 or 5.9999
+    std::string_view last_component;
+    while(true)
+    {
+        last_component = read_digits(false);
+        if(key_size != 0 and last_component.starts_with('0'))
+            append_zero_component(last_component);
+        else append_key_token(COMPONENT, last_component);
+
+        if(not rest.starts_with('.'))
+            break;
+        rest.remove_prefix(1);
+    }
+
+    live = last_component.starts_with("9999");
 
-    // check the string split for "9999" to know if the ebuild is a live one
-    update_live_bool(split);
+    if(not rest.empty() and rest.front() >= 'a' and rest.front() <= 'z')
+    {
+        append_key_token(LETTER, rest.front());
+        rest.remove_prefix(1);
+    }
 
-    long letter_number = 0;
-    ulong number = 0;
-    std::size_t end_pos;
-    bool letter_found = false;
+    // "_pre" has to be tried before "_p"
+    static const std::array<std::pair<std::string_view, KeyToken>, 5> suffixes =
+    {{
+        {"_alpha", ALPHA}, {"_beta", BETA}, {"_pre", PRE}, {"_rc", RC}, {"_p", PATCH}
+    }};
 
-    // convert split to version_parsing
-    for(auto &[index, str_view]: split)
+    while(rest.starts_with('_'))
     {
-        if(str_view.empty())
-        {
-            version_parsing.emplace_back(index, 0);
-            continue;
-        }
-
-        letter_found = isalpha(str_view.back(), std::locale("C"));
-        if(letter_found)
-        {
-            if(index != dot_index)
-                throw std::runtime_error("something is wrong with this version string: " + ver);
-
-            letter_number = str_view.back();
-            str_view.remove_suffix(1);
-        }
-
-        // one could use `strtoul` wiht str_view.data() but we cannot limit where to stop.
-        number = stoul(std::string(str_view), &end_pos);
-        if(end_pos == str_view.size())
-        {
-          version_parsing.emplace_back(index, number);
-          if(letter_found)
-              version_parsing.emplace_back(dot_index, letter_number);
-        }
-        else throw std::runtime_error("the following string couldn't be converted entirely to an integer: " + std::string(str_view));
+        auto suffix = std::ranges::find_if(suffixes, [&rest](const auto& suffix){ return rest.starts_with(suffix.first); });
+        if(suffix == suffixes.end())
+            throw invalid_format();
 
+        rest.remove_prefix(suffix->first.size());
+        append_key_token(suffix->second, read_digits(true));
     }
 
+    revisionless_key_size = key_size;
+
+    if(rest.starts_with("-r"))
+    {
+        rest.remove_prefix(2);
+        std::string_view revision = read_digits(false);
+        if(revision.find_first_not_of('0') != std::string_view::npos)
+            append_key_token(REVISION, revision);
+    }
+
+    if(not rest.empty())
+        throw invalid_format();
+
+    append_key_token(END, 0);
+
     version = std::move(ver);
 }
 
+int EbuildVersion::compare(const EbuildVersion &a, const EbuildVersion &b)
+{
+    // keys cannot be a prefix of one another, as they all end with the end marker
+    int res = std::memcmp(a.key.data(), b.key.data(), std::min(a.key_size, b.key_size));
+    return res != 0 ? res : int(a.key_size) - int(b.key_size);
+}
 
 bool operator < (const EbuildVersion &a, const EbuildVersion &b)
 {
     /* returns true if this < 1.23
-     * we lexicographically compare the two version_parsing variables at same size. If they are equal, we check the next subversion in the longer one to know if it's newer
+     * the keys are compared byte per byte, see EbuildVersion::set_version()
      *  examples:
-     *      [(".", 1), (".", 2)] < [(".", 1), (".", 3)] aka     1.2 < 1.3
-     *      [(".", 1)] < [(".", 1), ("_p", 1)]          aka     1 < 1_p1
-     *      [(".", 1)] < [(".", 1), ("-r", 1)]          aka     1 < 1-r1
-     *      [(".", 1), ("_rc", 1)] < [(".", 1)]         aka     1_rc1 < 1
-     *      Note: "-r", ".", "_rc" are actually referenced by their integer priority, given by their index in ordered_separators
+     *      1.2 < 1.3
+     *      1 < 1_p1
+     *      1 < 1-r1
+     *      1_rc1 < 1
      *      */
 
-    const std::size_t min_size = std::min(a.version_parsing.size(), b.version_parsing.size());
-    const auto res = lexicographical_compare_three_way(a.version_parsing.cbegin(),  a.version_parsing.cbegin() + long(min_size),
-                                                       b.version_parsing.cbegin(),  b.version_parsing.cbegin() + long(min_size));
-
-    bool result = res < 0 or (
-                            res == 0 and (
-                                    (a.version_parsing.size() > min_size and is_smaller_than_nothing(a.version_parsing[min_size].first)) or
-                                    (b.version_parsing.size() > min_size and not is_smaller_than_nothing(b.version_parsing[min_size].first))
-                            ));
-
-    return result;
+    return EbuildVersion::compare(a, b) < 0;
 }
 
 bool operator <= (const EbuildVersion &a, const EbuildVersion &b)
 {
     // returns true if this <= 1.23
 
-    const std::size_t min_size = std::min(a.version_parsing.size(), b.version_parsing.size());
-    const auto res = lexicographical_compare_three_way(a.version_parsing.cbegin(),  a.version_parsing.cbegin() + long(min_size),
-                                                       b.version_parsing.cbegin(),  b.version_parsing.cbegin() + long(min_size));
-
-    bool result = res <= 0 or (
-                            res == 0 and (
-                                    (a.version_parsing.size() > min_size and is_smaller_than_nothing(a.version_parsing[min_size].first)) or
-                                    (b.version_parsing.size() > min_size and not is_smaller_than_nothing(b.version_parsing[min_size].first))
-                            ));
-
-    return result;
+    return EbuildVersion::compare(a, b) <= 0;
 }
 
 bool operator >  (const EbuildVersion &a, const EbuildVersion &b)
 {
     // returns true if this > 1.23
 
-    return not (a <= b);
-
+    return EbuildVersion::compare(a, b) > 0;
 }
 
 bool operator >= (const EbuildVersion &a, const EbuildVersion &b)
 {
     // returns true if this >= 1.23
 
-    return not (a < b);
+    return EbuildVersion::compare(a, b) >= 0;
 }
 
 bool operator == (const EbuildVersion &a, const EbuildVersion &b)
 {
     // returns true if this = 1.23
 
-    if(a.version_parsing.size() != b.version_parsing.size())
-        return false;
-
-    const auto res = lexicographical_compare_three_way(a.version_parsing.cbegin(),  a.version_parsing.cend(),
-                                                       b.version_parsing.cbegin(),  b.version_parsing.cend());
-
-    return res == 0;
-
+    return a.key_size == b.key_size and std::memcmp(a.key.data(), b.key.data(), a.key_size) == 0;
 }
 
 bool operator *= (const EbuildVersion &a, const EbuildVersion &b)
 {
     // returns true if this matches with =1.23*
+    // the key of 1.23, without its end marker, has to start the key of this
 
     // 1.2 does not match with =1.2.3*
-    if(a.version_parsing.size() < b.version_parsing.size())
+    const std::size_t prefix_size = b.key_size == 0 ? 0 : b.key_size - 1;
+    if(a.key_size < prefix_size)
         return false;
 
-    const std::size_t min_size = b.version_parsing.size();
-    const auto res = lexicographical_compare_three_way(a.version_parsing.cbegin(),  a.version_parsing.cbegin() + long(min_size),
-                                                       b.version_parsing.cbegin(),  b.version_parsing.cbegin() + long(min_size));
-
-    return res == 0;
-
+    return std::memcmp(a.key.data(), b.key.data(), prefix_size) == 0;
 }
 
 bool operator ^= (const EbuildVersion &a, const EbuildVersion &b)
 {
     // returns true if this ~ 1.23
 
-    std::size_t rev_sep_index = index_of(a.ordered_separators, std::string("-r"));
-
-    // we compare packages without revision numbers. e.g. [(".", 1), (".", 2), ("-r", 1)] -> [(".", 1), (".", 2)]
-    const std::size_t size = a.version_parsing.back().first == rev_sep_index ? a.version_parsing.size() - 1 : a.version_parsing.size();
-    const std::size_t other_size = b.version_parsing.back().first == rev_sep_index ? b.version_parsing.size() - 1 : b.version_parsing.size();
-
-    // when the revision numbers are omitted, the version parsings should have the same length
-    if(size != other_size)
-        return false;
-
-    const auto res = lexicographical_compare_three_way(a.version_parsing.cbegin(),  a.version_parsing.cbegin() + long(size),
-                                                       b.version_parsing.cbegin(),  b.version_parsing.cbegin() + long(size));
-
-    return res == 0;
-
+    // we compare versions without revision numbers. e.g. 1.2-r1 -> 1.2
+    return a.revisionless_key_size == b.revisionless_key_size and
+            std::memcmp(a.key.data(), b.key.data(), a.revisionless_key_size) == 0;
 }
@@ -16,18 +16,103 @@ Package::Package(const std::string &pkg_group_name,
 
 vector<size_t> Package::get_matching_ebuild_ids(const PackageConstraint &constraint)
 {
+    const DynamicBitset matching = match_ebuilds(constraint);
+
     vector<size_t> matching_ebuilds;
+    for(EbuildID ebuild_id: get_version_order())
+        if(matching.contains(ebuild_id))
+            matching_ebuilds.push_back(ebuild_id);
+
+    return matching_ebuilds;
+}
+
+DynamicBitset Package::match_ebuilds(const PackageConstraint &constraint)
+{
+    /// \note the versions that respect the constraint are a range of the version order,
+    ///       found by binary search, only the slots of the ebuilds in it get checked
+
+    const vector<EbuildID> &order = get_version_order();
+    auto position_from = [&](EbuildID ebuild_id){ return columns->versions[ebuild_id].position_from(constraint.ver); };
+
+    auto first = std::ranges::partition_point(order, [&](EbuildID ebuild_id){ return position_from(ebuild_id) < 0; });
+    auto last = std::partition_point(first, order.end(), [&](EbuildID ebuild_id){ return position_from(ebuild_id) == 0; });
 
-    for(Ebuild &ebuild: ebuilds)
+    // the slot comes with the metadata
+    for(auto it = first ; it != last ; it++)
+        ebuilds[*it].parse_metadata();
+
+    // a slot that none of the ebuilds has matches nothing, an empty one anything
+    auto constraint_slot_id = [this](const string &slot_str)
     {
-        if(ebuild.respects_pkg_constraint(constraint))
-            matching_ebuilds.push_back(ebuild.get_id());
+        return slot_str.empty() ? SlotIndex::npos : slot_index->find(slot_str);
+    };
+
+    const SlotID slot_id = constraint_slot_id(constraint.slot.slot_str);
+    const SlotID subslot_id = constraint_slot_id(constraint.slot.subslot_str);
+
+    DynamicBitset matching;
+    if((slot_id == SlotIndex::npos and not constraint.slot.slot_str.empty()) or
+            (subslot_id == SlotIndex::npos and not constraint.slot.subslot_str.empty()))
+        return matching;
+
+    for(auto it = first ; it != last ; it++)
+        if(columns->respects_slot_ids(*it, slot_id, subslot_id))
+            matching.insert(*it);
+
+    return matching;
+}
+
+const DynamicBitset &Package::get_matching_ebuilds(AtomID atom_id)
+{
+    /// \note the cache is keyed by atom rather than by constraint string: dependency
+    ///       strings name the same few atoms over and over, and AtomIDs are dense
+
+    auto it = matching_ebuilds_cache.find(atom_id);
+    if(it == matching_ebuilds_cache.end())
+        it = matching_ebuilds_cache.emplace(atom_id, match_ebuilds(db->atoms[atom_id].pkg_constraint)).first;
+
+    return it->second;
+}
+
+const vector<EbuildID> &Package::get_version_order()
+{
+    if(version_order.size() != ebuilds.size())
+    {
+        version_order.resize(ebuilds.size());
+        for(EbuildID id = 0 ; id < ebuilds.size() ; id++)
+            version_order[id] = id;
+
+        std::ranges::sort(version_order, [this](EbuildID ebuild_id_1, EbuildID ebuild_id_2)
+                                         { return columns->versions[ebuild_id_1] < columns->versions[ebuild_id_2]; });
     }
 
-    std::ranges::sort(matching_ebuilds, [&](size_t ebuild_id_1, size_t ebuild_id_2)
-                                        { return ebuilds[ebuild_id_1] < ebuilds[ebuild_id_2];});
+    return version_order;
+}
 
-    return matching_ebuilds;
+const vector<vector<EbuildID>> &Package::get_slot_groups()
+{
+    if(slot_groups.empty() and not ebuilds.empty())
+    {
+        for(Ebuild &ebuild: ebuilds)
+            ebuild.parse_metadata();
+
+        // the last group gathers the ebuilds without a SLOT
+        slot_groups.resize(slot_index->size() + 1);
+        for(EbuildID ebuild_id: get_version_order())
+        {
+            SlotID slot_id = columns->slot_ids[ebuild_id];
+            slot_groups[slot_id == SlotIndex::npos ? slot_index->size() : slot_id].push_back(ebuild_id);
+        }
+    }
+
+    return slot_groups;
+}
+
+void Package::forget_matching_ebuilds()
+{
+    matching_ebuilds_cache.clear();
+    version_order.clear();
+    slot_groups.clear();
 }
 
 const string &Package::get_pkg_groupname() const
@@ -35,9 +120,84 @@ const string &Package::get_pkg_groupname() const
     return pkg_groupname;
 }
 
+void Package::serialize(BinaryWriter &writer) const
+{
+    writer.write(pkg_groupname);
+    writer.write(pkg_id);
+    writer.write(*flag_index);
+    writer.write(*slot_index);
+    writer.write(*columns);
+
+    writer.write(uint64_t(ebuilds.size()));
+    for(size_t i = 0 ; i < ebuilds.size() ; i++)
+    {
+        writer.write(ebuilds[i].get_version().string());
+        writer.write(ebuilds[i]);
+    }
+}
+
+void Package::deserialize(BinaryReader &reader)
+{
+    reader.read(pkg_groupname);
+    reader.read(pkg_id);
+
+    flag_index = make_shared<LocalFlagIndex>();
+    reader.read(*flag_index);
+
+    slot_index = make_shared<SlotIndex>();
+    reader.read(*slot_index);
+
+    columns = make_shared<EbuildColumns>();
+    reader.read(*columns);
+
+    ebuilds = NamedVector<Ebuild>();
+    forget_matching_ebuilds();
+    size_t ebuilds_num = reader.read<uint64_t>();
+    for(size_t i = 0 ; i < ebuilds_num ; i++)
+    {
+        string version = reader.read<string>();
+        ebuilds.push_back(Ebuild(db, columns.get(), i), version);
+        reader.read(ebuilds.back());
+        ebuilds.back().set_flag_index(flag_index.get());
+        ebuilds.back().set_slot_index(slot_index.get());
+    }
+}
+
+void Package::check_ids() const
+{
+    const size_t ebuilds_num = ebuilds.size();
+    if(columns->versions.size() != ebuilds_num or columns->slot_ids.size() != ebuilds_num or
+       columns->subslot_ids.size() != ebuilds_num or columns->states.size() != ebuilds_num)
+        throw runtime_error("Ebuild columns not matching the ebuilds of " + pkg_groupname);
+
+    const uint8_t all_states = EbuildColumns::INSTALLED | EbuildColumns::MASKED | EbuildColumns::KEYWORD_ACCEPTED;
+    for(size_t i = 0 ; i < ebuilds_num ; i++)
+    {
+        for(SlotID slot_id: {columns->slot_ids[i], columns->subslot_ids[i]})
+            if(slot_id != SlotIndex::npos and slot_id >= slot_index->size())
+                throw runtime_error("Unknown slot in " + pkg_groupname);
+
+        if((columns->states[i] & ~all_states) != 0)
+            throw runtime_error("Invalid ebuild state in " + pkg_groupname);
+    }
+
+    flag_index->check_ids(db->useflags.flags_count());
+
+    for(size_t i = 0 ; i < ebuilds_num ; i++)
+    {
+        if(ebuilds[i].get_id() != i or ebuilds[i].get_pkg_id() != pkg_id)
+            throw runtime_error("Invalid ebuild ID in " + pkg_groupname);
+        ebuilds[i].check_ids();
+    }
+}
+
 void Package::set_id(size_t pkg_id)
 {
     this->pkg_id = pkg_id;
+
+    // ebuilds can be added before the package gets its ID, e.g. when loading in parallel
+    for(auto &ebuild: ebuilds)
+        ebuild.set_pkg_id(pkg_id);
 }
 
 size_t Package::get_id() const
@@ -103,9 +263,12 @@ Ebuild& Package::add_version(const string &version)
     EbuildID ebuild_id = ebuild_id_of(version);
     if(ebuild_id == npos)
     {
-        ebuild_id = ebuilds.push_back(Ebuild(version, db), version);
-        ebuilds.back().set_id(ebuild_id);
+        ebuild_id = columns->push_back(EbuildVersion(version));
+        ebuilds.push_back(Ebuild(db, columns.get(), ebuild_id), version);
         ebuilds.back().set_pkg_id(pkg_id);
+        ebuilds.back().set_flag_index(flag_index.get());
+        ebuilds.back().set_slot_index(slot_index.get());
+        forget_matching_ebuilds();
     }
 
     return ebuilds[ebuild_id];
@@ -125,6 +288,30 @@ Ebuild& Package::add_installed_version(const string& version, const std::filesys
     return ebuild;
 }
 
+Ebuild& Package::add_installed_version(const string& version, const std::filesystem::path &ebuild_install_path,
+                                       optional<string_view> use_file_contents)
+{
+    Ebuild& ebuild = add_version(version);
+    ebuild.set_install_path(ebuild_install_path, use_file_contents);
+    return ebuild;
+}
+
+void Package::remove_version(const string &version)
+{
+    /// \note the IDs of the ebuilds that come after the removed one change
+
+    EbuildID ebuild_id = ebuild_id_of(version);
+    if(ebuild_id == npos)
+        return;
+
+    ebuilds.erase(ebuild_id);
+    columns->erase(ebuild_id);
+    for(EbuildID id = ebuild_id ; id < ebuilds.size() ; id++)
+        ebuilds[id].set_id(id);
+
+    forget_matching_ebuilds();
+}
+
 void Package::assign_useflag_states(const PackageConstraint &constraint,
                                     const UseflagStates &useflag_states,
                                     const FlagAssignType &assign_type)
@@ -165,6 +165,33 @@ PkgAcceptkeywords Parser::parse_pkg_accept_keywords_line(std::string_view pkg_ac
     return parse_pkg_settings<SettingsType::ACCEPT_KEYWORDS>(pkg_accept_keywords_line);
 }
 
+size_t Parser::parse_pkg_settings_pkg_id(string_view pkg_settings_line)
+{
+    // same early return as parse_pkg_settings()
+    skim_spaces_at_the_edges(pkg_settings_line);
+    auto first_space_char = pkg_settings_line.find(' ');
+    if(pkg_settings_line.empty() or pkg_settings_line.starts_with('#') or first_space_char == string_view::npos)
+        return PackageConstraint().pkg_id;
+
+    string_view str = pkg_settings_line.substr(0, first_space_char);
+    str = str.substr(0, str.find(':'));
+
+    size_t name_start = str.find_first_not_of("<>=~");
+    if(name_start == string_view::npos)
+        throw runtime_error("Cannot parse package constraint " + string(str));
+
+    // with a version operator, the name is followed by a version
+    if(name_start != 0)
+    {
+        str.remove_prefix(name_start);
+        if(str.ends_with('*'))
+            str.remove_suffix(1);
+        str = str.substr(0, pkg_namever_split_pos(str));
+    }
+
+    return db->repo.get_pkg_id(str);
+}
+
 PackageDependency Parser::parse_pkg_dependency(string_view pkg_dep_str)
 {
     string_view str(pkg_dep_str);
@@ -394,12 +421,14 @@ UseDependencies Parser::parse_pkg_usedeps(string_view useflags_constraint_str)
         usedep.direct_dep.default_if_unexisting = false;
         if(single_constraint.ends_with("(+)"))
         {
+            usedep.direct_dep.has_default_if_unexisting = true;
             usedep.direct_dep.default_if_unexisting = true;
             single_constraint.remove_suffix(3);
         }
         if(single_constraint.ends_with("(-)"))
         {
-            usedep.direct_dep.default_if_unexisting = true;
+            usedep.direct_dep.has_default_if_unexisting = true;
+            usedep.direct_dep.default_if_unexisting = false;
             single_constraint.remove_suffix(3);
         }
 
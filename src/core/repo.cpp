@@ -6,9 +6,17 @@
 #include <stdexcept>
 #include <chrono>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <array>
+#include <algorithm>
+#include <ranges>
 using namespace std::chrono;
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 #define FMT_HEADER_ONLY
 #include <fmt/format.h>
 
@@ -16,18 +24,81 @@ using namespace std::chrono;
 #include "quantum-resolver/database.h"
 #include "quantum-resolver/utils/string_utils.h"
 #include "quantum-resolver/utils/file_utils.h"
+#include "quantum-resolver/utils/thread_utils.h"
+#include "quantum-resolver/utils/pipeline.h"
 
 using namespace std;
 namespace fs = filesystem;
 
+static PackageSetting parse_package_setting(Parser &parser, const PackageSettingsLine &settings_line)
+{
+    PackageSetting setting{settings_line.type, settings_line.assign_type, {}, {}, {}};
+
+    if(settings_line.type == PackageSettingsLine::Type::ACCEPT_KEYWORDS)
+        tie(setting.pkg_constraint, setting.accept_keywords) = parser.parse_pkg_accept_keywords_line(settings_line.line);
+    else tie(setting.pkg_constraint, setting.use_toggles) = parser.parse_pkguse_line(settings_line.line);
+
+    return setting;
+}
+
+static void apply_package_setting(Package &pkg, const PackageSetting &setting)
+{
+    //TODO : deal with assigning unexisting useflags
+    if(setting.type == PackageSettingsLine::Type::ACCEPT_KEYWORDS)
+        pkg.accept_keywords(setting.pkg_constraint, setting.accept_keywords);
+    else pkg.assign_useflag_states(setting.pkg_constraint, setting.use_toggles, setting.assign_type);
+}
+
 Repo::Repo(Database *db) : db(db)
 {
-    load_ebuilds("/var/db/repos/gentoo/metadata/md5-cache");
+}
+
+void Repo::load()
+{
+    load_ebuilds(md5_cache_path, true);
     load_installed_pkgs();
     load_system_packages();
     load_selected_packages();
-    load_package_accept_keywords();
-    load_package_useflag_settings();
+    load_package_settings();
+    number_ebuilds();
+}
+
+void Repo::load_lazily()
+{
+    lazy = true;
+
+    load_ebuilds(md5_cache_path, false);
+    load_installed_pkgs();
+    load_system_packages();
+    load_selected_packages();
+    load_package_settings();
+
+    unloaded_pkgs.assign(pkgs.size(), true);
+    number_ebuilds();
+}
+
+void Repo::load_package(PackageID pkg_id)
+{
+    unloaded_pkgs[pkg_id] = false;
+
+    Package &pkg = pkgs[pkg_id];
+    const size_t ebuilds_num = pkg.size();
+
+    if(auto it = unloaded_installed_versions.find(pkg_id) ; it != unloaded_installed_versions.end())
+    {
+        for(const auto &[pkg_ver, install_path]: it->second)
+            pkg.add_installed_version(pkg_ver, install_path);
+        unloaded_installed_versions.erase(it);
+    }
+
+    pkg.parse_metadata();
+
+    for(size_t setting_index: pkg_settings[pkg_id])
+        parsed_pkg_settings[setting_index] = parse_package_setting(db->parser, pkg_settings_lines[setting_index]);
+    apply_package_settings(pkg_id);
+
+    if(pkg.size() != ebuilds_num)
+        number_ebuilds();
 }
 
 void Repo::load_system_packages()
@@ -56,10 +127,9 @@ void Repo::load_system_packages()
 
 void Repo::load_selected_packages()
 {
-    fs::path selected_packages("/var/lib/portage/world");
-    if(fs::is_regular_file(selected_packages))
+    if(fs::is_regular_file(selected_pkgs_path))
     {
-        for(string_view pkg_atom: read_file_lines(selected_packages))
+        for(string_view pkg_atom: read_file_lines(selected_pkgs_path))
         {
             auto constraint = db->parser.parse_pkg_constraint(pkg_atom);
             if(constraint.pkg_id != pkgs.npos)
@@ -69,15 +139,85 @@ void Repo::load_selected_packages()
     }
 }
 
-void Repo::load_package_accept_keywords()
+void Repo::serialize(BinaryWriter &writer) const
 {
-    for(const auto &path: get_regular_files("/etc/portage/package.accept_keywords"))
-        for(string_view line: read_file_lines(path))
-        {
-            const auto &[pkg_constraint, accept_keywords] = db->parser.parse_pkg_accept_keywords_line(line);
-            if(pkg_constraint.pkg_id != pkgs.npos) //TODO : deal with assigning unexisting useflags
-                pkgs[pkg_constraint.pkg_id].accept_keywords(pkg_constraint, accept_keywords);
-        }
+    writer.write(uint64_t(pkgs.size()));
+    for(size_t pkg_id = 0 ; pkg_id < pkgs.size() ; pkg_id++)
+        writer.write(pkgs[pkg_id]);
+
+    writer.write(std::tie(selected_pkgs, system_pkgs));
+    writer.write(std::tie(pkg_settings_lines, parsed_pkg_settings, cache_category_mtimes, installed_category_mtimes));
+}
+
+void Repo::deserialize(BinaryReader &reader)
+{
+    pkgs = NamedVector<Package>();
+    size_t pkgs_num = reader.read<uint64_t>();
+    for(size_t pkg_id = 0 ; pkg_id < pkgs_num ; pkg_id++)
+    {
+        Package pkg("", db);
+        reader.read(pkg);
+
+        string pkg_groupname = pkg.get_pkg_groupname();
+        pkgs.push_back(std::move(pkg), std::move(pkg_groupname));
+    }
+
+    auto sets = std::tie(selected_pkgs, system_pkgs);
+    reader.read(sets);
+
+    auto refresh_state = std::tie(pkg_settings_lines, parsed_pkg_settings, cache_category_mtimes, installed_category_mtimes);
+    reader.read(refresh_state);
+
+    // before anything gets indexed by package ID
+    check_ids();
+
+    index_package_settings();
+    number_ebuilds();
+}
+
+void Repo::check_ids() const
+{
+    /// \brief throws std::runtime_error if a package ID, or an ID of a package, is out of range
+
+    for(PackageID pkg_id = 0 ; pkg_id < pkgs.size() ; pkg_id++)
+    {
+        if(pkgs[pkg_id].get_id() != pkg_id)
+            throw runtime_error("Invalid package ID for " + pkgs[pkg_id].get_pkg_groupname());
+        pkgs[pkg_id].check_ids();
+    }
+
+    for(const auto *pkg_set: {&selected_pkgs, &system_pkgs})
+        for(PackageID pkg_id: *pkg_set)
+            if(pkg_id >= pkgs.size())
+                throw runtime_error("Package set naming an unknown package");
+
+    if(parsed_pkg_settings.size() != pkg_settings_lines.size())
+        throw runtime_error("Package settings not matching their lines");
+
+    auto is_known_pkg = [this](PackageID pkg_id){ return pkg_id == npos or pkg_id < pkgs.size(); };
+    auto is_known_flag = [this](FlagID flag_id){ return flag_id < db->useflags.flags_count(); };
+    for(size_t i = 0 ; i < pkg_settings_lines.size() ; i++)
+    {
+        const PackageSetting &setting = parsed_pkg_settings[i];
+        if(not is_known_pkg(pkg_settings_lines[i].pkg_id) or not is_known_pkg(setting.pkg_constraint.pkg_id) or
+           not ranges::all_of(setting.use_toggles | views::keys, is_known_flag) or
+           not ranges::all_of(setting.accept_keywords.explicitely_defined | views::keys, is_known_flag))
+            throw runtime_error("Package setting naming an unknown package or flag");
+    }
+}
+
+void Repo::number_ebuilds()
+{
+    /// \brief gives the global ebuild IDs, package after package
+
+    pkg_offsets.resize(pkgs.size());
+    ebuild_pkg_ids.clear();
+
+    for(PackageID pkg_id = 0 ; pkg_id < pkgs.size() ; pkg_id++)
+    {
+        pkg_offsets[pkg_id] = ebuild_pkg_ids.size();
+        ebuild_pkg_ids.insert(ebuild_pkg_ids.end(), pkgs[pkg_id].size(), pkg_id);
+    }
 }
 
 bool Repo::is_system_pkg(PackageID pkg_id) const { return system_pkgs.contains(pkg_id); };
@@ -86,54 +226,292 @@ bool Repo::is_selected_pkg(PackageID pkg_id) const { return selected_pkgs.contai
 std::size_t Repo::get_pkg_id(const std::string_view &pkg_str) const { return pkgs.index_of(pkg_str);};
 const std::string& Repo::get_pkg_groupname(std::size_t pkg_id) const { return pkgs[pkg_id].get_pkg_groupname(); };
 
-void Repo::load_package_useflag_settings()
+const vector<pair<string, FlagAssignType>> Repo::pkguse_profile_files =
 {
-    const vector<pair<string, FlagAssignType>> pkguse_profile_files =
-    {
-        {"package.use", FlagAssignType::DIRECT},
-        {"package.stable.use", FlagAssignType::STABLE_DIRECT},
+    {"package.use", FlagAssignType::DIRECT},
+    {"package.stable.use", FlagAssignType::STABLE_DIRECT},
 
-        {"package.use.force", FlagAssignType::FORCE},
-        {"package.use.stable.force", FlagAssignType::STABLE_FORCE},
+    {"package.use.force", FlagAssignType::FORCE},
+    {"package.use.stable.force", FlagAssignType::STABLE_FORCE},
 
-        {"package.use.mask", FlagAssignType::MASK},
-        {"package.use.stable.mask", FlagAssignType::STABLE_MASK},
-    };
+    {"package.use.mask", FlagAssignType::MASK},
+    {"package.use.stable.mask", FlagAssignType::STABLE_MASK},
+};
 
-    cout << "Reading profile tree and forwarding per package use, force and mask flags to ebuilds" << endl;
-    auto start = high_resolution_clock::now();
+vector<PackageSettingsLine> Repo::read_package_settings_lines()
+{
+    /// \brief every per package setting line, in the order they have to be applied:
+    ///        accepted keywords first, then the use files of each profile, from the
+    ///        most generic one to /etc/portage
+    /// \note  the lines do not get their package ID here
+
+    vector<PackageSettingsLine> lines;
+
+    for(const auto &path: get_regular_files(rooted_path("/etc/portage/package.accept_keywords")))
+        for(string &line: read_file_lines(path))
+            lines.push_back({PackageSettingsLine::Type::ACCEPT_KEYWORDS, FlagAssignType::DIRECT, std::move(line), npos});
 
     for(const auto& profile_path : flatenned_profiles_tree)
         for(const auto& [profile_use_file, use_type]: pkguse_profile_files)
             for(const auto &path: get_regular_files(profile_path.string() + "/" + profile_use_file))
-                for(string_view line: read_file_lines(path))
-                {
-                    const auto &[pkg_constraint, use_toggles] = db->parser.parse_pkguse_line(line);
-                    if(pkg_constraint.pkg_id != pkgs.npos) //TODO : deal with assigning unexisting useflags
-                        pkgs[pkg_constraint.pkg_id].assign_useflag_states(pkg_constraint, use_toggles, use_type);
-                }
+                for(string &line: read_file_lines(path))
+                    lines.push_back({PackageSettingsLine::Type::USEFLAGS, use_type, std::move(line), npos});
+
+    return lines;
+}
+
+void Repo::load_package_settings()
+{
+    /// \brief parses every line in parallel, then gathers them per package and applies
+    ///        them in parallel, one package at a time
+    /// \note  the lines of a package keep their relative order, which is all that profile
+    ///        order means: a setting only ever touches the ebuilds of the package it names
+
+    cout << "Reading profile tree and forwarding per package use, force and mask flags to ebuilds" << endl;
+    auto start = high_resolution_clock::now();
+
+    pkg_settings_lines = read_package_settings_lines();
+
+    // lazily, a line only gets its package name read, load_package() parses the rest
+    parsed_pkg_settings.assign(pkg_settings_lines.size(), {});
+    db->executor.parallel_for(pkg_settings_lines.size(), [&](size_t i)
+    {
+        if(lazy)
+            pkg_settings_lines[i].pkg_id = db->parser.parse_pkg_settings_pkg_id(pkg_settings_lines[i].line);
+        else
+        {
+            parsed_pkg_settings[i] = parse_package_setting(db->parser, pkg_settings_lines[i]);
+            pkg_settings_lines[i].pkg_id = parsed_pkg_settings[i].pkg_constraint.pkg_id;
+        }
+    });
+
+    index_package_settings();
+
+    if(not lazy)
+        db->executor.parallel_for(pkgs.size(), [&](size_t pkg_id)
+        {
+            for(size_t setting_index: pkg_settings[pkg_id])
+                apply_package_setting(pkgs[pkg_id], parsed_pkg_settings[setting_index]);
+        });
 
     auto end = high_resolution_clock::now();
     cout << "duration : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
 }
 
+void Repo::index_package_settings()
+{
+    /// \brief gathers the lines of each package, in the order they have to be applied
+
+    pkg_settings.assign(pkgs.size(), {});
+    for(size_t i = 0 ; i < pkg_settings_lines.size() ; i++)
+        if(pkg_settings_lines[i].pkg_id != npos)
+            pkg_settings[pkg_settings_lines[i].pkg_id].push_back(i);
+}
 
-void Repo::load_ebuilds(const std::string &path)
+void Repo::apply_package_settings(PackageID pkg_id)
+{
+    /// \brief puts the ebuilds of the package back to their global flag states
+    ///        and keyword acceptance, then applies the lines that concern the package
+
+    for(auto &ebuild: pkgs[pkg_id])
+        ebuild.reset_flag_states();
+
+    // packages added since the last index have no line
+    if(pkg_id >= pkg_settings.size())
+        return;
+
+    for(size_t setting_index: pkg_settings[pkg_id])
+        apply_package_setting(pkgs[pkg_id], parsed_pkg_settings[setting_index]);
+}
+
+void Repo::load_ebuilds(const std::filesystem::path &cache_path, bool read_cache_entries)
 {
-    fs::path cache_path(path);
     if(not fs::is_directory(cache_path))
         throw runtime_error("Path is not a directory");
 
-    cout << "Reading cached ebuilds from " + path << endl;
+    cout << "Reading cached ebuilds from " + cache_path.string() << endl;
     auto start = high_resolution_clock::now();
 
-    for(fs::directory_entry const& entry: fs::recursive_directory_iterator(cache_path))
+    // sorted so that package IDs do not depend on the order the filesystem lists directories
+    vector<fs::path> category_paths;
+    for(fs::directory_entry const& entry: fs::directory_iterator(cache_path))
+        if(entry.is_directory())
+            category_paths.push_back(entry.path());
+    ranges::sort(category_paths);
+
+    // refresh() only looks into the categories whose folder got modified since
+    for(const auto& category_path: category_paths)
+        cache_category_mtimes[category_path.filename().string()] = get_mtime(category_path);
+
+    // every category gets its own package table, filled by whichever worker picks it up
+    vector<NamedVector<Package>> category_pkgs(category_paths.size());
+    if(read_cache_entries)
+        category_pkgs = load_categories_with_cache_entries(category_paths);
+    else db->executor.parallel_for(category_paths.size(), [&](size_t i)
+    {
+        category_pkgs[i] = load_category_ebuilds(category_paths[i]);
+    });
+
+    // merge in category order: package IDs are the same from one run to another
+    for(auto& cat_pkgs: category_pkgs)
+        for(size_t i = 0 ; i < cat_pkgs.size() ; i++)
+        {
+            string pkg_category_name = cat_pkgs.name_of(i);
+            size_t pkg_id = pkgs.push_back(std::move(cat_pkgs[i]), std::move(pkg_category_name));
+            pkgs.back().set_id(pkg_id);
+        }
+
+    auto end = high_resolution_clock::now();
+    cout << "Loaded ebuilds in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+}
+
+vector<NamedVector<Package>> Repo::load_categories_with_cache_entries(const vector<fs::path> &category_paths)
+{
+    /// \brief lists the categories, reads their md5-cache entries and parses the IUSE, SLOT and
+    ///        KEYWORDS of their ebuilds at the same time, through a pipeline:
+    ///        walk (1 thread) -> paths -> read (io_uring batches) -> contents -> parse (workers)
+    /// \note  bounded queues hold each stage back when the next one lags behind, so that only
+    ///        a few thousand entries are in memory at once between reading and parsing.
+    ///        Entries go through the queues in batches, a thread wakes up per batch rather than per entry
+    /// \note  dependencies are left to parse_deps(): their atoms need the whole package table
+
+    // where an entry goes: the packages of a category do not move once the walker listed them
+    struct EntryLocation
     {
-        if(not (entry.is_regular_file() and entry.path().parent_path().parent_path() == cache_path))
-            continue;
+        size_t category_index, pkg_index;
+        EbuildID ebuild_id;
+    };
 
-        const string &pkg_namever = entry.path().filename(); // we use filename here because the cache files do not contain any extension
-        const string &pkg_category = entry.path().parent_path().stem();
+    struct EntryPaths
+    {
+        vector<EntryLocation> locations;
+        vector<fs::path> paths;
+    };
+
+    struct EntryContents
+    {
+        vector<EntryLocation> locations;
+        vector<fs::path> paths;
+        vector<string> contents;
+    };
+
+    constexpr size_t batch_size = 128;
+
+    vector<NamedVector<Package>> category_pkgs(category_paths.size());
+
+    BoundedQueue<EntryPaths> paths_queue(32);
+    BoundedQueue<EntryContents> contents_queue(16);
+
+    // the readers open descriptors by the hundred
+    reserve_file_descriptors();
+
+    Pipeline pipeline;
+    pipeline.add_queue(paths_queue);
+    pipeline.add_queue(contents_queue);
+
+    const StageCounters &walk_counters = pipeline.add_stage("walk", 1, [&](StageCounters &counters)
+    {
+        EntryPaths batch;
+        for(size_t category_index = 0 ; category_index < category_paths.size() ; category_index++)
+        {
+            NamedVector<Package> &pkgs_of_category = category_pkgs[category_index];
+            pkgs_of_category = load_category_ebuilds(category_paths[category_index]);
+
+            // batches hold whole packages: the ebuilds of a package share its flag and slot
+            // indices, a single parse worker has to handle them all
+            for(size_t pkg_index = 0 ; pkg_index < pkgs_of_category.size() ; pkg_index++)
+            {
+                for(const Ebuild &ebuild: pkgs_of_category[pkg_index])
+                {
+                    batch.locations.push_back({category_index, pkg_index, ebuild.get_id()});
+                    batch.paths.push_back(ebuild.get_ebuild_path());
+                    counters.items++;
+                }
+
+                if(batch.paths.size() >= batch_size)
+                {
+                    if(not paths_queue.push(std::move(batch), &counters))
+                        return;
+                    batch = EntryPaths();
+                }
+            }
+        }
+
+        if(not batch.paths.empty())
+            paths_queue.push(std::move(batch), &counters);
+    }, [&]{ paths_queue.close(); });
+
+    // io_uring already keeps a whole batch of reads in flight, more threads only help the pread() fallback:
+    // with io_uring, a second reader would only share the descriptors the batches may hold
+    const size_t readers_num = io_uring_reads_available() ? 1 : min<size_t>(2, db->executor.size());
+    const StageCounters &read_counters = pipeline.add_stage("read", readers_num, [&](StageCounters &counters)
+    {
+        while(optional<EntryPaths> batch = paths_queue.pop(&counters))
+        {
+            EntryContents read_batch;
+            read_files_in_order(batch->paths, [&](size_t i, string_view contents)
+            {
+                read_batch.locations.push_back(batch->locations[i]);
+                read_batch.paths.push_back(std::move(batch->paths[i]));
+                read_batch.contents.emplace_back(contents);
+
+                counters.items++;
+                counters.bytes += contents.size();
+            });
+
+            if(not contents_queue.push(std::move(read_batch), &counters))
+                return;
+        }
+    }, [&]{ contents_queue.close(); });
+
+    pipeline.add_stage("parse", db->executor.size(), [&](StageCounters &counters)
+    {
+        while(optional<EntryContents> batch = contents_queue.pop(&counters))
+        {
+            for(size_t i = 0 ; i < batch->paths.size() ; i++)
+            {
+                const EntryLocation &location = batch->locations[i];
+                Ebuild &ebuild = category_pkgs[location.category_index][location.pkg_index][location.ebuild_id];
+
+                ebuild.set_cache_entry(Ebuild::read_cache_entry(batch->paths[i], batch->contents[i]));
+                ebuild.parse_metadata();
+            }
+
+            counters.items += batch->paths.size();
+        }
+    });
+
+    pipeline.join();
+
+    for(const StageCounters &stage: pipeline.get_stages())
+        cout << fmt::format("  {:<5} {:>6} entries {:>8}kB, waited for input {:>4}ms, for output {:>4}ms",
+                            stage.name, stage.items.load(), stage.bytes / 1024,
+                            stage.starved_us / 1000, stage.blocked_us / 1000) << endl;
+
+    // e.g. removed since the walk: their ebuilds try again on their own once parsed
+    if(walk_counters.items != read_counters.items)
+        cout << fmt::format("  {} entries could not be read", walk_counters.items - read_counters.items) << endl;
+
+    return category_pkgs;
+}
+
+NamedVector<Package> Repo::load_category_ebuilds(const std::filesystem::path &category_path)
+{
+    /// Reads the md5-cache entries of a single category, e.g. .../md5-cache/sys-devel
+    /// The returned packages have no ID yet, load_ebuilds() assigns them when merging
+
+    vector<fs::path> entry_paths;
+    for(fs::directory_entry const& entry: fs::directory_iterator(category_path))
+        if(entry.is_regular_file())
+            entry_paths.push_back(entry.path());
+    ranges::sort(entry_paths);
+
+    const string &pkg_category = category_path.filename().string();
+
+    NamedVector<Package> category_pkgs;
+    for(const fs::path& entry_path: entry_paths)
+    {
+        const string &pkg_namever = entry_path.filename(); // we use filename here because the cache files do not contain any extension
 
         const size_t &split_pos = pkg_namever_split_pos(pkg_namever);
 
@@ -141,73 +519,494 @@ void Repo::load_ebuilds(const std::string &path)
         const string &pkg_ver = pkg_namever.substr(split_pos+1);
 
         const string &pkg_category_name = pkg_category + "/" + pkg_name;
-        size_t pkg_id = pkgs.index_of(pkg_category_name);
-        if(pkg_id == pkgs.npos)
-        {
-            pkg_id = pkgs.push_back(Package(pkg_category_name, db), pkg_category_name);
-            pkgs.back().set_id(pkg_id);
-        }
+        size_t pkg_index = category_pkgs.index_of(pkg_category_name);
+        if(pkg_index == category_pkgs.npos)
+            pkg_index = category_pkgs.push_back(Package(pkg_category_name, db), pkg_category_name);
 
-        Package &pkg = pkgs[pkg_id];
-        pkg.add_repo_version(pkg_ver, entry.path());
+        category_pkgs[pkg_index].add_repo_version(pkg_ver, entry_path);
     }
 
-    auto end = high_resolution_clock::now();
-    cout << "Loaded ebuilds in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+    return category_pkgs;
 }
 
 void Repo::load_installed_pkgs()
 {
-    fs::path installed_pkgs_path("/var/db/pkg");
     if(not fs::is_directory(installed_pkgs_path))
         throw runtime_error("Path is not a directory");
 
     cout << "Reading installed ebuilds from " + installed_pkgs_path.string() << endl;
     auto start = high_resolution_clock::now();
 
-    for(fs::directory_entry const& category_entry: fs::directory_iterator(installed_pkgs_path))
+    load_installed_categories(get_subdirectories(installed_pkgs_path));
+
+    auto end = high_resolution_clock::now();
+    cout << "duration : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+}
+
+void Repo::load_installed_category(const std::filesystem::path &category_path)
+{
+    /// Reads the installed packages of a single category, e.g. /var/db/pkg/sys-devel
+
+    load_installed_categories({category_path});
+}
+
+void Repo::load_installed_categories(const vector<fs::path> &category_paths)
+{
+    /// \brief registers the installed packages of the categories, their USE files are read in one go
+
+    struct InstalledEntry
     {
-        if(not category_entry.is_directory())
-            continue;
+        PackageID pkg_id;
+        string pkg_ver;
+        fs::path path;
+    };
+    vector<InstalledEntry> entries;
 
-        const string &pkg_category = category_entry.path().filename().string();
+    for(const fs::path &category_path: category_paths)
+    {
+        const string &pkg_category = category_path.filename().string();
+        installed_category_mtimes[pkg_category] = get_mtime(category_path);
 
-        for(fs::directory_entry const& pkg_namever_entry: fs::directory_iterator(category_entry.path()))
+        for(const fs::path &pkg_namever_path: get_subdirectories(category_path))
         {
-            if(not pkg_namever_entry.is_directory())
-                continue;
-
-            const string &pkg_namever = pkg_namever_entry.path().filename().string();
+            const string &pkg_namever = pkg_namever_path.filename().string();
             const size_t &split_pos = pkg_namever_split_pos(pkg_namever);
 
             const string &pkg_name = pkg_namever.substr(0, split_pos);
             const string &pkg_ver = pkg_namever.substr(split_pos+1);
 
             const size_t &pkg_id = pkgs.index_of(pkg_category + "/" + pkg_name);
-            if(pkg_id != pkgs.npos)
-                pkgs[pkg_id].add_installed_version(pkg_ver, pkg_namever_entry);
+            if(pkg_id != pkgs.npos and lazy)
+                unloaded_installed_versions[pkg_id].emplace_back(pkg_ver, pkg_namever_path);
+            else if(pkg_id != pkgs.npos)
+                entries.push_back({pkg_id, pkg_ver, pkg_namever_path});
             else cout << pkg_category + "/" + pkg_name + " not in the ::gentoo repository" << endl;
-
         }
     }
 
-    auto end = high_resolution_clock::now();
-    cout << "duration : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+    vector<fs::path> use_paths;
+    use_paths.reserve(entries.size());
+    for(const auto &entry: entries)
+        use_paths.push_back(entry.path / "USE");
+
+    // an entry without a USE file keeps std::nullopt
+    vector<optional<string>> use_files(entries.size());
+    read_files(use_paths, [&use_files](size_t i, string_view contents)
+    {
+        use_files[i] = string(contents);
+    }, db->executor);
+
+    for(size_t i = 0 ; i < entries.size() ; i++)
+        pkgs[entries[i].pkg_id].add_installed_version(entries[i].pkg_ver, entries[i].path, use_files[i]);
 }
 
-void Repo::parse_ebuild_metadata()
+void Repo::load_ebuild_cache_entries()
 {
+    /// \brief reads the md5-cache entries that parse_ebuild_metadata() is about to need, in bulk
+    /// \note  an entry that can't be read is left to Ebuild::load_data(), which reports it
+
+    vector<Ebuild*> ebuilds;
+    vector<fs::path> entry_paths;
     for(auto &pkg: pkgs)
-        pkg.parse_metadata();
+        for(auto &ebuild: pkg)
+            if(ebuild.needs_cache_entry())
+            {
+                ebuilds.push_back(&ebuild);
+                entry_paths.push_back(ebuild.get_ebuild_path());
+            }
+
+    read_files(entry_paths, [&ebuilds](size_t i, string_view contents)
+    {
+        ebuilds[i]->set_cache_entry(contents);
+    }, db->executor);
+}
+
+void Repo::parse_ebuild_metadata()
+{
+    /// \brief parses IUSE, SLOT and KEYWORDS of every ebuild, one package per work item
+    /// \note  the ebuilds of a package share its flag index, so a package is never split between threads
+
+    auto start = high_resolution_clock::now();
+
+    load_ebuild_cache_entries();
+
+    db->executor.parallel_for(pkgs.size(), [this](size_t pkg_id)
+    {
+        pkgs[pkg_id].parse_metadata();
+    });
+
+    auto end = high_resolution_clock::now();
+    cout << "Parsed ebuild metadata in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
 }
 
 void Repo::parse_deps()
 {
+    /// \brief parses the BDEPEND, IDEPEND, DEPEND, RDEPEND and PDEPEND strings of every ebuild
+    /// \note  only reads the package table, which does not change while parsing
+
     auto start = high_resolution_clock::now();
 
-    for(auto &pkg: pkgs)
-        pkg.parse_deps();
+    db->executor.parallel_for(pkgs.size(), [this](size_t pkg_id)
+    {
+        pkgs[pkg_id].parse_deps();
+    });
+
+#ifdef __GLIBC__
+    // the raw metadata of the ebuilds has just been freed, in small blocks spread over the
+    // arenas of the worker threads, which glibc otherwise keeps for later allocations
+    malloc_trim(0);
+#endif
 
     auto end = high_resolution_clock::now();
-    cout << "Parsing time : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+    cout << "Parsed dependencies in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+}
+
+std::vector<PackageID> Repo::get_category_pkg_ids(const std::string &category) const
+{
+    const string prefix = category + "/";
+
+    vector<PackageID> category_pkg_ids;
+    for(PackageID pkg_id = 0 ; pkg_id < pkgs.size() ; pkg_id++)
+        if(pkgs[pkg_id].get_pkg_groupname().starts_with(prefix))
+            category_pkg_ids.push_back(pkg_id);
+
+    return category_pkg_ids;
+}
+
+static map<string, int64_t> get_category_mtimes(const fs::path &path)
+{
+    map<string, int64_t> category_mtimes;
+    for(const fs::path &category_path: get_subdirectories(path))
+        category_mtimes[category_path.filename().string()] = get_mtime(category_path);
+
+    return category_mtimes;
+}
+
+static vector<string> get_changed_categories(const map<string, int64_t> &known_mtimes,
+                                             const map<string, int64_t> &current_mtimes)
+{
+    /// \brief categories that got modified, added or removed
+
+    vector<string> changed_categories;
+    for(const auto& [category, mtime]: current_mtimes)
+    {
+        auto it = known_mtimes.find(category);
+        if(it == known_mtimes.end() or it->second != mtime)
+            changed_categories.push_back(category);
+    }
+
+    for(const auto& [category, mtime]: known_mtimes)
+        if(not current_mtimes.contains(category))
+            changed_categories.push_back(category);
+
+    return changed_categories;
+}
+
+bool Repo::refresh()
+{
+    cout << "Refreshing the repository with what changed on disk" << endl;
+    auto start = high_resolution_clock::now();
+
+    const size_t pkgs_num = pkgs.size();
+    const size_t flags_num = db->useflags.flags_count();
+
+    // packages whose ebuilds have to get their per package settings applied again
+    unordered_set<PackageID> touched_pkgs;
+
+    refresh_ebuilds(touched_pkgs);
+    refresh_installed_pkgs(touched_pkgs);
+    refresh_package_settings(touched_pkgs);
+
+    // a re-read entry can have changed its slot
+    for(PackageID pkg_id: touched_pkgs)
+    {
+        pkgs[pkg_id].forget_matching_ebuilds();
+        apply_package_settings(pkg_id);
+    }
+
+    // atoms that named packages or flags unknown at the time may resolve now
+    size_t reparsed_ebuilds = 0;
+    if(pkgs.size() != pkgs_num or db->useflags.flags_count() != flags_num)
+    {
+        db->atoms.reparse_unresolved_atoms();
+
+        for(auto &pkg: pkgs)
+            for(auto &ebuild: pkg)
+                if(not ebuild.has_complete_deps())
+                {
+                    ebuild.reparse_deps();
+                    reparsed_ebuilds++;
+                }
+    }
+
+    bool changed_sets = refresh_package_sets();
+
+    if(not touched_pkgs.empty())
+        number_ebuilds();
+
+    auto end = high_resolution_clock::now();
+    fmt::print("Refreshed {} packages ({} new), re-parsed the dependencies of {} ebuilds in : {}ms\n",
+               touched_pkgs.size(), pkgs.size() - pkgs_num, reparsed_ebuilds,
+               duration_cast<milliseconds>(end - start).count());
+
+    return not touched_pkgs.empty() or reparsed_ebuilds != 0 or changed_sets;
+}
+
+void Repo::refresh_ebuilds(unordered_set<PackageID> &touched_pkgs)
+{
+    /// \brief reads again the md5-cache categories whose folder got modified
+    /// \note  rsync, git and egencache replace entries through renames, which bumps
+    ///        the modification time of the category folder
+    /// \note  an entry is only parsed again if its _md5_ or _eclasses_ changed
+
+    auto category_mtimes = get_category_mtimes(md5_cache_path);
+
+    for(const string &category: get_changed_categories(cache_category_mtimes, category_mtimes))
+    {
+        NamedVector<Package> category_pkgs;
+        if(category_mtimes.contains(category))
+            category_pkgs = load_category_ebuilds(md5_cache_path / category);
+
+        // entries that are gone
+        for(PackageID pkg_id: get_category_pkg_ids(category))
+        {
+            Package &pkg = pkgs[pkg_id];
+            size_t cat_pkg_index = category_pkgs.index_of(pkg.get_pkg_groupname());
+
+            vector<string> removed_versions;
+            for(Ebuild &ebuild: pkg)
+            {
+                const string &version = ebuild.get_version().string();
+                if(not ebuild.get_ebuild_path().empty() and
+                        (cat_pkg_index == category_pkgs.npos or category_pkgs[cat_pkg_index].ebuild_id_of(version) == Package::npos))
+                    removed_versions.push_back(version);
+            }
+
+            for(const string &version: removed_versions)
+            {
+                Ebuild &ebuild = pkg[version];
+                if(ebuild.is_installed())
+                {
+                    // only known from /var/db/pkg from now on
+                    ebuild.set_ebuild_path(fs::path());
+                    ebuild.reload_metadata();
+                }
+                else pkg.remove_version(version);
+
+                touched_pkgs.insert(pkg_id);
+            }
+        }
+
+        // new and modified entries
+        for(size_t i = 0 ; i < category_pkgs.size() ; i++)
+        {
+            string pkg_category_name = category_pkgs.name_of(i);
+            PackageID pkg_id = pkgs.index_of(pkg_category_name);
+            if(pkg_id == pkgs.npos)
+            {
+                // appended: the IDs of the other packages stay valid
+                pkg_id = pkgs.push_back(std::move(category_pkgs[i]), std::move(pkg_category_name));
+                pkgs.back().set_id(pkg_id);
+                touched_pkgs.insert(pkg_id);
+                continue;
+            }
+
+            Package &pkg = pkgs[pkg_id];
+            for(Ebuild &cat_ebuild: category_pkgs[i])
+            {
+                const string &version = cat_ebuild.get_version().string();
+                EbuildID ebuild_id = pkg.ebuild_id_of(version);
+
+                if(ebuild_id == Package::npos)
+                    pkg.add_repo_version(version, cat_ebuild.get_ebuild_path());
+                else if(pkg[ebuild_id].get_ebuild_path().empty())
+                {
+                    // was only known from /var/db/pkg
+                    pkg[ebuild_id].set_ebuild_path(cat_ebuild.get_ebuild_path());
+                    pkg[ebuild_id].reload_metadata();
+                }
+                else if(pkg[ebuild_id].cache_entry_changed())
+                    pkg[ebuild_id].reload_metadata();
+                else continue;
+
+                touched_pkgs.insert(pkg_id);
+            }
+        }
+
+        if(category_mtimes.contains(category))
+            cache_category_mtimes[category] = category_mtimes[category];
+        else cache_category_mtimes.erase(category);
+    }
+}
+
+void Repo::refresh_installed_pkgs(unordered_set<PackageID> &touched_pkgs)
+{
+    /// \brief reads again the /var/db/pkg categories whose folder got modified
+
+    auto category_mtimes = get_category_mtimes(installed_pkgs_path);
+
+    for(const string &category: get_changed_categories(installed_category_mtimes, category_mtimes))
+    {
+        const vector<PackageID> category_pkg_ids = get_category_pkg_ids(category);
+
+        // forget the install state of the whole category, then read it again
+        for(PackageID pkg_id: category_pkg_ids)
+        {
+            Package &pkg = pkgs[pkg_id];
+
+            vector<string> installed_versions;
+            for(Ebuild &ebuild: pkg)
+                if(ebuild.is_installed())
+                    installed_versions.push_back(ebuild.get_version().string());
+
+            for(const string &version: installed_versions)
+            {
+                if(pkg[version].get_ebuild_path().empty())
+                    pkg.remove_version(version);
+                else pkg[version].set_uninstalled();
+
+                touched_pkgs.insert(pkg_id);
+            }
+        }
+
+        if(category_mtimes.contains(category))
+            load_installed_category(installed_pkgs_path / category);
+        else installed_category_mtimes.erase(category);
+
+        for(PackageID pkg_id: category_pkg_ids)
+            for(Ebuild &ebuild: pkgs[pkg_id])
+                if(ebuild.is_installed())
+                    touched_pkgs.insert(pkg_id);
+    }
+}
+
+bool Repo::refresh_installed_entry(const string &category, const string &pkg_namever)
+{
+    const fs::path category_path = installed_pkgs_path / category;
+    const fs::path entry_path = category_path / pkg_namever;
+
+    const size_t split_pos = pkg_namever_split_pos(pkg_namever);
+    const string pkg_name = pkg_namever.substr(0, split_pos);
+    const string pkg_ver = pkg_namever.substr(split_pos+1);
+
+    const PackageID pkg_id = pkgs.index_of(category + "/" + pkg_name);
+    if(pkg_id == npos)
+        return false;
+
+    Package &pkg = pkgs[pkg_id];
+    const EbuildID ebuild_id = pkg.ebuild_id_of(pkg_ver);
+    const bool installed = fs::is_directory(entry_path);
+
+    // the next refresh() must not read the category again for this
+    if(int64_t mtime = get_mtime(category_path) ; mtime != 0)
+        installed_category_mtimes[category] = mtime;
+    else installed_category_mtimes.erase(category);
+
+    if(not installed)
+    {
+        if(ebuild_id == Package::npos or not pkg[ebuild_id].is_installed())
+            return false;
+
+        // versions that are not in the md5-cache go away with their /var/db/pkg entry
+        if(pkg[ebuild_id].get_ebuild_path().empty())
+        {
+            pkg.remove_version(pkg_ver);
+            number_ebuilds();
+        }
+        else pkg[ebuild_id].set_uninstalled();
+
+        return true;
+    }
+
+    if(ebuild_id != Package::npos and not pkg[ebuild_id].get_ebuild_path().empty())
+    {
+        // newly installed or re-emerged: only the install time flags are read
+        pkg[ebuild_id].set_install_path(entry_path);
+        return true;
+    }
+
+    // a version that is not in the md5-cache is read again as a whole
+    if(ebuild_id != Package::npos)
+        pkg.remove_version(pkg_ver);
+
+    pkg.add_installed_version(pkg_ver, entry_path);
+    apply_package_settings(pkg_id);
+    number_ebuilds();
+
+    return true;
+}
+
+void Repo::refresh_package_settings(unordered_set<PackageID> &touched_pkgs)
+{
+    /// \brief reads the per package settings again, the packages whose sequence
+    ///        of lines changed get touched
+    /// \note  only the lines that were not there before get parsed here
+
+    auto settings_lines = read_package_settings_lines();
+
+    // indexed by line type: the index of each line of a known package
+    array<unordered_map<string, size_t>, 2> known_lines;
+    for(size_t i = 0 ; i < pkg_settings_lines.size() ; i++)
+        if(pkg_settings_lines[i].pkg_id != npos)
+            known_lines[size_t(pkg_settings_lines[i].type)][pkg_settings_lines[i].line] = i;
+
+    vector<PackageSetting> settings(settings_lines.size());
+    for(size_t i = 0 ; i < settings_lines.size() ; i++)
+    {
+        auto &known = known_lines[size_t(settings_lines[i].type)];
+        if(auto it = known.find(settings_lines[i].line) ; it != known.end())
+        {
+            settings[i] = parsed_pkg_settings[it->second];
+            settings[i].assign_type = settings_lines[i].assign_type;
+        }
+        else settings[i] = parse_package_setting(db->parser, settings_lines[i]);
+
+        settings_lines[i].pkg_id = settings[i].pkg_constraint.pkg_id;
+    }
+
+    auto lines_per_pkg = [](const vector<PackageSettingsLine> &lines)
+    {
+        unordered_map<PackageID, vector<const PackageSettingsLine*>> pkg_lines;
+        for(const auto& settings_line: lines)
+            if(settings_line.pkg_id != npos)
+                pkg_lines[settings_line.pkg_id].push_back(&settings_line);
+        return pkg_lines;
+    };
+
+    auto old_pkg_lines = lines_per_pkg(pkg_settings_lines);
+    auto new_pkg_lines = lines_per_pkg(settings_lines);
+
+    auto same_lines = [](const vector<const PackageSettingsLine*> &lines, const vector<const PackageSettingsLine*> &other_lines)
+    {
+        return ranges::equal(lines, other_lines, [](const auto* line, const auto* other_line){ return *line == *other_line; });
+    };
+
+    for(const auto& [pkg_id, lines]: new_pkg_lines)
+        if(not old_pkg_lines.contains(pkg_id) or not same_lines(lines, old_pkg_lines[pkg_id]))
+            touched_pkgs.insert(pkg_id);
+
+    for(const auto& [pkg_id, lines]: old_pkg_lines)
+        if(not new_pkg_lines.contains(pkg_id))
+            touched_pkgs.insert(pkg_id);
+
+    pkg_settings_lines = std::move(settings_lines);
+    parsed_pkg_settings = std::move(settings);
+    index_package_settings();
+}
+
+bool Repo::refresh_package_sets()
+{
+    /// \brief reads the system and selected sets again, they are small enough
+    /// \return true if one of them changed
+
+    auto old_system_pkgs = std::move(system_pkgs);
+    auto old_selected_pkgs = std::move(selected_pkgs);
+
+    system_pkgs.clear();
+    selected_pkgs.clear();
+
+    load_system_packages();
+    load_selected_packages();
+
+    return system_pkgs != old_system_pkgs or selected_pkgs != old_selected_pkgs;
 }
@@ -9,6 +9,7 @@
 #include <filesystem>
 #include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string_view>
 
 #define FMT_HEADER_ONLY
@@ -20,9 +21,95 @@ using namespace std;
 
 const unordered_set<string> UseFlags::incremental_vars = {"USE", "USE_EXPAND", "USE_EXPAND_HIDDEN", "IUSE_IMPLICIT", "USE_EXPAND_IMPLICIT", "USE_EXPAND_UNPREFIXED", "ACCEPT_KEYWORDS"};
 
+LocalFlagIndex::LocalFlagID LocalFlagIndex::insert(FlagID flag_id)
+{
+    auto it = ranges::lower_bound(sorted_local_ids, flag_id, {}, [this](uint32_t local_id){ return flag_ids[local_id]; });
+    if(it != sorted_local_ids.end() and flag_ids[*it] == flag_id)
+        return *it;
+
+    sorted_local_ids.insert(it, uint32_t(flag_ids.size()));
+    flag_ids.push_back(flag_id);
+    return flag_ids.size() - 1;
+}
+
+LocalFlagIndex::LocalFlagID LocalFlagIndex::find(FlagID flag_id) const
+{
+    auto it = ranges::lower_bound(sorted_local_ids, flag_id, {}, [this](uint32_t local_id){ return flag_ids[local_id]; });
+    if(it != sorted_local_ids.end() and flag_ids[*it] == flag_id)
+        return *it;
+    return npos;
+}
+
+DynamicBitset LocalFlagIndex::select(const DynamicBitset &local_flags, const DynamicBitset &flags) const
+{
+    DynamicBitset selection;
+    for(LocalFlagID local_id: local_flags)
+        if(flags.contains(flag_ids[local_id]))
+            selection.insert(local_id);
+    return selection;
+}
+
+vector<FlagID> LocalFlagIndex::to_flag_ids(const DynamicBitset &local_flags) const
+{
+    vector<FlagID> ids;
+    for(LocalFlagID local_id: local_flags)
+        ids.push_back(flag_ids[local_id]);
+    return ids;
+}
+
+void LocalFlagIndex::check_ids(size_t flags_count) const
+{
+    if(sorted_local_ids.size() != flag_ids.size())
+        throw runtime_error("Invalid local flag index");
+
+    // strictly increasing flags: the local IDs are distinct, so a permutation
+    for(size_t i = 0 ; i < sorted_local_ids.size() ; i++)
+        if(sorted_local_ids[i] >= flag_ids.size() or flag_ids[sorted_local_ids[i]] >= flags_count or
+           (i > 0 and flag_ids[sorted_local_ids[i - 1]] >= flag_ids[sorted_local_ids[i]]))
+            throw runtime_error("Invalid local flag index");
+}
+
 UseFlags::UseFlags(Database *db) : db(db)
 {
-    populate_profile_flags();
+}
+
+void UseFlags::serialize(BinaryWriter &writer) const
+{
+    writer.write(use_expand);
+    writer.write(useflags);
+    writer.write(std::tie(implicit_useflags, hidden_useflags, expand_useflags));
+    writer.write(std::tie(use, use_mask, use_force, use_stable_force, use_stable_mask));
+    writer.write(std::tie(current_arch, current_arch_name, accepted_keywords));
+}
+
+void UseFlags::deserialize(BinaryReader &reader)
+{
+    reader.read(use_expand);
+    reader.read(useflags);
+
+    auto flag_categories = std::tie(implicit_useflags, hidden_useflags, expand_useflags);
+    reader.read(flag_categories);
+
+    auto global_states = std::tie(use, use_mask, use_force, use_stable_force, use_stable_mask);
+    reader.read(global_states);
+
+    auto arch = std::tie(current_arch, current_arch_name, accepted_keywords);
+    reader.read(arch);
+}
+
+void UseFlags::check_ids() const
+{
+    for(const DynamicBitset *flags: {&implicit_useflags, &hidden_useflags, &expand_useflags,
+                                     &use, &use_mask, &use_force, &use_stable_force, &use_stable_mask})
+        if(flags->bound() > flags_count())
+            throw runtime_error("Flag set naming an unknown flag");
+
+    if(current_arch != npos and current_arch >= flags_count())
+        throw runtime_error("Unknown arch flag");
+
+    for(const auto &[arch, state]: accepted_keywords.explicitely_defined)
+        if(arch >= flags_count())
+            throw runtime_error("Keyword naming an unknown arch");
 }
 
 void UseFlags::set_arch()
@@ -32,7 +119,7 @@ void UseFlags::set_arch()
         if(use.contains(flag))
         {
             current_arch = flag;
-            current_arch_name = useflags.get_counterpart(current_arch);
+            current_arch_name = useflags.name(current_arch);
             break;
         }
 }
@@ -61,59 +148,58 @@ FlagName UseFlags::get_arch_name() const
     return current_arch_name;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_implicit_flags() const
+const DynamicBitset& UseFlags::get_implicit_flags() const
 {
     return implicit_useflags;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_hidden_flags() const
+const DynamicBitset& UseFlags::get_hidden_flags() const
 {
     return hidden_useflags;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_expand_flags() const
+const DynamicBitset& UseFlags::get_expand_flags() const
 {
     return expand_useflags;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_use() const
+const DynamicBitset& UseFlags::get_use() const
 {
     return use;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_use_force() const
+const DynamicBitset& UseFlags::get_use_force() const
 {
     return use_force;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_use_stable_force() const
+const DynamicBitset& UseFlags::get_use_stable_force() const
 {
     return use_stable_force;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_use_mask() const
+const DynamicBitset& UseFlags::get_use_mask() const
 {
     return use_mask;
 }
 
-const std::unordered_set<FlagID>& UseFlags::get_use_stable_mask() const
+const DynamicBitset& UseFlags::get_use_stable_mask() const
 {
     return use_stable_mask;
 }
 
 size_t UseFlags::add_flag(const string_view &flag_str)
 {
-    auto it = useflags.find_couple(string(flag_str));
-    if(it == useflags.cend())
+    auto [flag_id, new_flag] = useflags.insert(flag_str);
+    if(new_flag)
     {
-        useflags.add_couple(string(flag_str), useflags.size());
-        FlagID flag_id = useflags.size() - 1;
-
         size_t underscore_pos = flag_str.find_last_of('_');
         if(underscore_pos != string_view::npos) // so we catch e.g. l18n_en
         {
             string_view prefix = flag_str.substr(0, underscore_pos); // We obtain here L18N
 
+            scoped_lock lock(*new_flags_mutex);
+
             // See if it corresponds to any use expand name
             ExpandID expand_id = use_expand.index_from_key(UseExpandName(prefix));
 
@@ -125,31 +211,24 @@ size_t UseFlags::add_flag(const string_view &flag_str)
                 expand_useflags.insert(flag_id);
             }
         }
-        return  flag_id;
     }
-    return it->second;
+    return flag_id;
 }
 
 size_t UseFlags::get_flag_id(const std::string_view &flag_str) const
 {
-    auto it = useflags.find_couple(string(flag_str));
-    if(it == useflags.cend())
-    {
-        return npos;
-    }
-    return it->second;
+    return useflags.find(flag_str);
 }
 
 const std::string& UseFlags::get_flag_name(const size_t &id) const
 {
-    auto it = useflags.find_couple(id);
-    if(it == useflags.cend())
+    if(not useflags.contains(id))
         throw runtime_error(fmt::format("flag ID {} doesn't exist", id));
 
-    return it->first;
+    return useflags.name(id);
 }
 
-void UseFlags::handle_use_line(string_view flags, unordered_set<FlagID>& container)
+void UseFlags::handle_use_line(string_view flags, DynamicBitset& container)
 {
     while(not flags.empty())
     {
@@ -368,7 +447,7 @@ void UseFlags::populate_profile_flags()
     cout << "Reading global forced and masked flags from profile tree" << endl;
     auto start = high_resolution_clock::now();
 
-    vector<tuple<string, unordered_set<size_t>&>> profile_use_files_and_type =
+    vector<tuple<string, DynamicBitset&>> profile_use_files_and_type =
     {
         {"use.force", use_force},
         {"use.stable.force", use_stable_force},
@@ -1,8 +1,229 @@
 #include "quantum-resolver/database.h"
+#include "quantum-resolver/utils/file_utils.h"
+#include "quantum-resolver/utils/serialization.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <system_error>
+
+#include <unistd.h>
 
 using namespace std;
+using namespace std::chrono;
+namespace fs = filesystem;
+
+Database::Database(LoadMode mode) :  parser(this), useflags(this), atoms(this), repo(this)
+{
+    if(mode == LoadMode::LAZY)
+    {
+        useflags.populate_profile_flags();
+        repo.load_lazily();
+        return;
+    }
+
+    const bool use_snapshot = (mode == LoadMode::SNAPSHOT);
+    if(use_snapshot and load_snapshot())
+    {
+        if(refresh())
+            save_snapshot();
+        return;
+    }
+
+    load();
+
+    if(use_snapshot)
+        save_snapshot();
+}
 
-Database::Database() :  parser(this), useflags(this), repo(this)
+void Database::load()
 {
+    loaded_profiles_fingerprint = profiles_fingerprint();
+
+    useflags.populate_profile_flags();
+    repo.load();
+}
+
+bool Database::refresh()
+{
+    if(profiles_fingerprint() == loaded_profiles_fingerprint)
+        return repo.refresh();
+
+    // global flags changed: every ebuild is concerned
+    cout << "The profiles changed, loading everything again" << endl;
+
+    useflags = UseFlags(this);
+    atoms = AtomTable(this);
+    repo = Repo(this);
+    load();
+
+    return true;
+}
+
+fs::path Database::snapshot_path()
+{
+    if(const char* env_path = getenv("QUANTUM_SNAPSHOT"))
+        return fs::path(env_path);
+
+    if(geteuid() == 0)
+        return "/var/cache/quantum-resolver/database.snapshot";
+
+    fs::path cache_dir;
+    if(const char* xdg_cache = getenv("XDG_CACHE_HOME"); xdg_cache != nullptr and *xdg_cache != '\0')
+        cache_dir = xdg_cache;
+    else if(const char* home = getenv("HOME"))
+        cache_dir = fs::path(home) / ".cache";
+    else cache_dir = fs::temp_directory_path();
+
+    return cache_dir / "quantum-resolver" / "database.snapshot";
+}
+
+uint64_t Database::profiles_fingerprint()
+{
+    /// \brief hashes the modification times of the profile files that define the global flag states
+    /// \note  the package.* files and the md5-cache, /var/db/pkg and world file are left
+    ///        out: Repo::refresh() deals with them without reloading everything
+
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    auto hash_bytes = [&hash](const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0 ; i < size ; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    auto hash_path = [&](const fs::path &path)
+    {
+        error_code ec;
+        const string &path_str = path.string();
+        hash_bytes(path_str.data(), path_str.size());
+
+        auto status = fs::symlink_status(path, ec);
+        if(ec or not fs::exists(status))
+        {
+            hash_bytes("missing", 7);
+            return;
+        }
+
+        auto mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+        hash_bytes(&mtime, sizeof(mtime));
+
+        if(fs::is_regular_file(status))
+        {
+            auto size = fs::file_size(path, ec);
+            hash_bytes(&size, sizeof(size));
+        }
+    };
+
+    for(const auto& profile_path: flatenned_profiles_tree)
+    {
+        hash_path(profile_path);
+        if(not fs::is_directory(profile_path))
+            continue;
+
+        vector<fs::path> profile_files;
+        for(auto it = fs::recursive_directory_iterator(profile_path) ; it != fs::recursive_directory_iterator() ; it++)
+        {
+            // e.g. package.use/, package.accept_keywords, packages
+            if(it->path().filename().string().starts_with("package"))
+            {
+                it.disable_recursion_pending();
+                continue;
+            }
+
+            profile_files.push_back(it->path());
+        }
+
+        ranges::sort(profile_files);
+        for(const auto& file: profile_files)
+            hash_path(file);
+    }
+
+    return hash;
+}
+
+bool Database::load_snapshot()
+{
+    fs::path path = snapshot_path();
+    if(path.empty() or not fs::is_regular_file(path))
+        return false;
+
+    auto start = high_resolution_clock::now();
+
+    try
+    {
+        MappedFile snapshot_file(path);
+        BinaryReader reader(snapshot_file.view());
+
+        if(string_view(reader.read_bytes(snapshot_magic.size()), snapshot_magic.size()) != snapshot_magic or
+                reader.read<uint32_t>() != snapshot_format_version)
+            return false;
+
+        reader.read(loaded_profiles_fingerprint);
+        reader.read(useflags);
+        reader.read(atoms);
+        reader.read(repo);
+
+        if(not reader.at_end())
+            throw runtime_error("trailing data");
+
+        // the repository checks its own IDs, these need the packages to be known
+        useflags.check_ids();
+        atoms.check_ids();
+    }
+    catch(const exception &err)
+    {
+        cout << "Ignoring database snapshot " << path.string() << ": " << err.what() << endl;
+
+        // start over from a clean state
+        useflags = UseFlags(this);
+        atoms = AtomTable(this);
+        repo = Repo(this);
+        return false;
+    }
+
+    auto end = high_resolution_clock::now();
+    cout << "Loaded database snapshot in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
+
+    return true;
+}
+
+void Database::save_snapshot()
+{
+    fs::path path = snapshot_path();
+    if(path.empty())
+        return;
+
+    cout << "Parsing the whole tree to write the database snapshot" << endl;
+    auto start = high_resolution_clock::now();
+
+    // the snapshot is only worth it if it spares all the text parsing
+    repo.parse_ebuild_metadata();
+    repo.parse_deps();
+
+    BinaryWriter writer;
+    writer.write_bytes(snapshot_magic.data(), snapshot_magic.size());
+    writer.write(snapshot_format_version);
+    writer.write(loaded_profiles_fingerprint);
+    writer.write(useflags);
+    writer.write(atoms);
+    writer.write(repo);
+
+    try
+    {
+        fs::create_directories(path.parent_path());
+        write_file_atomically(path, writer.data());
+    }
+    catch(const exception &err)
+    {
+        cout << "Could not write database snapshot " << path.string() << ": " << err.what() << endl;
+        return;
+    }
 
+    auto end = high_resolution_clock::now();
+    cout << "Wrote database snapshot in : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
 }
@@ -5,6 +5,8 @@ using namespace std::chrono;
 using namespace std;
 
 #include "quantum-resolver/cli/cli_interface.h"
+#include "quantum-resolver/cli/daemon.h"
+#include "quantum-resolver/utils/file_utils.h"
 
 int main(int argc, char *argv[])
 {
@@ -17,13 +19,31 @@ int main(int argc, char *argv[])
 //        input.push_back("status");
 //        input.push_back("sys-devel/clang");
 
+        if(input.size() == 1 and input[0] == "daemon")
+        {
+            Daemon daemon;
+            daemon.serve();
+            return 0;
+        }
+
         auto start = high_resolution_clock::now();
-        CommandLineInterface cli(input);
+        // a running daemon answers without loading anything
+        if(not Daemon::forward(input))
+        {
+            // a single package only needs that package to be read
+            bool single_pkg = (input.size() == 2 and input[0] == "status");
+            Database db(single_pkg ? Database::LoadMode::LAZY : Database::LoadMode::SNAPSHOT);
+            CommandLineInterface cli(db);
+            cli.run(input);
+        }
         auto end = high_resolution_clock::now();
 
         cout << "#####################################################" << endl;
         cout << "Total time : " << duration_cast<milliseconds>(end - start).count() << "ms" << endl;
 
+        MemoryUsage memory = read_memory_usage();
+        cout << "Memory : " << memory.resident_kb / 1024 << "MB resident, " << memory.peak_resident_kb / 1024 << "MB peak" << endl;
+
     }
     catch(runtime_error &err)
     {
@@ -1,6 +1,386 @@
+#include <algorithm>
+
 #include "quantum-resolver/resolver.h"
+#include "quantum-resolver/database.h"
+
+using namespace std;
+
+Resolver::Resolver(Database *db) : db(db)
+{
+}
+
+Resolution Resolver::resolve(const std::vector<PackageDependency> &atoms, bool allow_use_changes)
+{
+    solver = SatSolver();
+    ebuild_vars.assign(db->repo.ebuilds_count(), no_var);
+    flag_vars.clear();
+    ebuilds_to_encode.clear();
+
+    this->allow_use_changes = allow_use_changes;
+
+    true_lit = SatSolver::pos(solver.new_var(true));
+    false_lit = SatSolver::negate(true_lit);
+    solver.add_clause({true_lit});
+
+    for(const auto& atom: atoms)
+        encode_pkg_dep(atom, AtomTable::npos, true_lit, Repo::npos, Ebuild::npos);
+
+    // encoding an ebuild's dependencies can pull in new packages, whose ebuilds get queued
+    while(not ebuilds_to_encode.empty())
+    {
+        auto [pkg_id, ebuild_id] = ebuilds_to_encode.front();
+        ebuilds_to_encode.pop_front();
+        encode_ebuild(pkg_id, ebuild_id);
+    }
+
+    Resolution resolution;
+    resolution.vars_count = solver.vars_count();
+    resolution.clauses_count = solver.clauses_count();
+
+    resolution.solved = solver.solve() == SatSolver::Result::SATISFIABLE;
+    resolution.solver_stats = solver.get_stats();
+
+    if(resolution.solved)
+        resolution.ebuilds = read_solution();
+
+    return resolution;
+}
+
+void Resolver::encode_package(PackageID pkg_id)
+{
+    /// \brief creates the variables of every ebuild of the package, then queues them for encoding
+
+    Package &pkg = db->repo[pkg_id];
+
+    // the slot and keywords come with the metadata, parsed by get_slot_groups()
+    const auto &slot_groups = pkg.get_slot_groups();
+    const vector<EbuildID> &ebuild_ids = pkg.get_version_order();
+    const EbuildColumns &columns = pkg.get_columns();
+
+    const GlobalEbuildID first_global_id = db->repo.global_ebuild_id(pkg_id, 0);
+
+    for(size_t rank = 0 ; rank < ebuild_ids.size() ; rank++)
+    {
+        EbuildID ebuild_id = ebuild_ids[rank];
+        const bool installed = columns.has(ebuild_id, EbuildColumns::INSTALLED);
+
+        // every variable gets decided false first, unless installed, the lowest versions
+        // get decided first so that the highest ones are the last standing
+        double activity = 1e-3 * double(ebuild_ids.size() - rank);
+        ebuild_vars[first_global_id + ebuild_id] = solver.new_var(installed, activity);
+
+        Lit selected = SatSolver::pos(ebuild_vars[first_global_id + ebuild_id]);
+
+        if(not installed and (columns.has(ebuild_id, EbuildColumns::MASKED) or
+                              not columns.has(ebuild_id, EbuildColumns::KEYWORD_ACCEPTED)))
+            solver.add_clause({SatSolver::negate(selected)});
 
-Resolver::Resolver()
+        ebuilds_to_encode.emplace_back(pkg_id, ebuild_id);
+    }
+
+    // the slot index also numbers the subslots, whose groups are empty
+    for(const vector<EbuildID> &slot_group: slot_groups)
+    {
+        if(slot_group.size() < 2)
+            continue;
+
+        vector<Lit> ebuild_lits;
+        for(EbuildID ebuild_id: slot_group)
+            ebuild_lits.push_back(SatSolver::pos(ebuild_vars[first_global_id + ebuild_id]));
+        solver.add_at_most_one(ebuild_lits);
+    }
+}
+
+void Resolver::encode_ebuild(PackageID pkg_id, EbuildID ebuild_id)
 {
+    Ebuild &ebuild = db->repo[pkg_id][ebuild_id];
+    Lit selected = ebuild_lit(pkg_id, ebuild_id);
+
+    // RDEPEND and PDEPEND: an installed ebuild keeps needing them
+    if(not ebuild.get_rdeps().empty())
+        encode_deps(ebuild.get_rdeps(), 0, selected, pkg_id, ebuild_id);
+
+    // BDEPEND, DEPEND and IDEPEND only matter for what has to be built
+    if((not ebuild.is_installed() or not ebuild.get_changed_flags().empty()) and not ebuild.get_bdeps().empty())
+        encode_deps(ebuild.get_bdeps(), 0, selected, pkg_id, ebuild_id);
+}
+
+void Resolver::encode_deps(const Dependencies &deps, size_t node_index, Lit condition, PackageID pkg_id, EbuildID ebuild_id)
+{
+    /// \brief adds clauses that make 'condition' imply the node at 'node_index' of 'deps'
+    /// \note  pkg_id and ebuild_id designate the ebuild the dependencies belong to
+
+    if(condition == false_lit)
+        return;
+
+    const DependencyNode &node = deps.nodes[node_index];
+    auto encode_children = [&](Lit children_condition)
+    {
+        deps.for_each_child(node_index, [&](size_t child){
+            encode_deps(deps, child, children_condition, pkg_id, ebuild_id);
+        });
+    };
+
+    switch(node.type)
+    {
+    case DependencyNode::Type::PACKAGE:
+        encode_pkg_dep(db->atoms[node.payload], node.payload, condition, pkg_id, ebuild_id);
+        break;
+    case DependencyNode::Type::ALL_OF:
+        encode_children(condition);
+        break;
+    case DependencyNode::Type::USE_CONDITION:
+        encode_children(and_lit(condition, flag_lit(pkg_id, ebuild_id, node.payload, node.flag_state)));
+        break;
+    case DependencyNode::Type::ANY_OF:
+        encode_choice(deps, node_index, condition, ChoiceType::AT_LEAST_ONE, pkg_id, ebuild_id);
+        break;
+    case DependencyNode::Type::EXACTLY_ONE_OF:
+        encode_choice(deps, node_index, condition, ChoiceType::EXACTLY_ONE, pkg_id, ebuild_id);
+        break;
+    case DependencyNode::Type::AT_MOST_ONE_OF:
+        encode_choice(deps, node_index, condition, ChoiceType::AT_MOST_ONE, pkg_id, ebuild_id);
+        break;
+    }
+}
+
+void Resolver::encode_choice(const Dependencies &deps, size_t node_index, Lit condition, ChoiceType type, PackageID pkg_id, EbuildID ebuild_id)
+{
+    /// \brief || ( ), ^^ ( ) and ?? ( ) groups: every alternative gets a variable that implies it
+    /// \note  ^^ and ?? constrain the alternatives that get picked, an alternative that is
+    ///        satisfied without being picked does not count
+
+    if(condition == false_lit)
+        return;
+
+    vector<Lit> choices;
+    deps.for_each_child(node_index, [&](size_t child)
+    {
+        // earlier alternatives are preferred: later ones get decided (false) first
+        Lit choice = new_aux_lit(1e-6 * double(choices.size() + 1));
+        choices.push_back(choice);
+
+        const DependencyNode &child_node = deps.nodes[child];
+        if(child_node.type != DependencyNode::Type::USE_CONDITION)
+        {
+            encode_deps(deps, child, choice, pkg_id, ebuild_id);
+            return;
+        }
+
+        // a disabled conditional group cannot be the alternative that gets picked
+        solver.add_clause({SatSolver::negate(choice), flag_lit(pkg_id, ebuild_id, child_node.payload, child_node.flag_state)});
+        deps.for_each_child(child, [&](size_t grand_child){
+            encode_deps(deps, grand_child, choice, pkg_id, ebuild_id);
+        });
+    });
+
+    if(type != ChoiceType::AT_MOST_ONE)
+    {
+        vector<Lit> clause = choices;
+        clause.push_back(SatSolver::negate(condition));
+        solver.add_clause(std::move(clause));
+    }
+
+    if(type != ChoiceType::AT_LEAST_ONE)
+        solver.add_at_most_one(choices);
+}
+
+void Resolver::encode_pkg_dep(const PackageDependency &pkg_dep, AtomID atom_id, Lit condition, PackageID pkg_id, EbuildID ebuild_id)
+{
+    /// \brief 'condition' implies that one of the matching ebuilds is selected with the
+    ///        requested flag states, or none of them for blockers
+    /// \param atom_id: ID of 'pkg_dep' in the atom table, whose matching ebuilds get cached,
+    ///        or AtomTable::npos for atoms that aren't interned, e.g. the requested ones
+
+    if(condition == false_lit)
+        return;
+
+    const PackageConstraint &constraint = pkg_dep.pkg_constraint;
+    const bool blocker = pkg_dep.blocker_type != PackageDependency::BlockerType::NONE;
+
+    if(constraint.pkg_id == Repo::npos)
+    {
+        // nothing provides it
+        if(not blocker)
+            solver.add_clause({SatSolver::negate(condition)});
+        return;
+    }
+
+    // an ebuild does not block the other versions of its own package
+    if(blocker and constraint.pkg_id == pkg_id)
+        return;
+
+    Package &pkg = db->repo[constraint.pkg_id];
+    DynamicBitset scanned;
+    const DynamicBitset &matching = atom_id == AtomTable::npos ? (scanned = pkg.match_ebuilds(constraint))
+                                                               : pkg.get_matching_ebuilds(atom_id);
+
+    vector<Lit> candidates;
+    for(EbuildID matching_id: matching)
+    {
+        Ebuild &ebuild = pkg[matching_id];
+        Lit selected = ebuild_lit(constraint.pkg_id, ebuild.get_id());
+
+        if(blocker)
+        {
+            // the blocked ebuild cannot be selected with the flag states named by the blocker
+            vector<Lit> clause = {SatSolver::negate(condition), SatSolver::negate(selected)};
+            bool can_match = true;
+            for(const auto& use_dep: pkg_dep.use_dependencies)
+                if(use_dep.type == UseflagDependency::Type::DIRECT)
+                {
+                    Lit flag = usedep_lit(constraint.pkg_id, ebuild.get_id(), use_dep, use_dep.direct_dep.state);
+                    can_match = can_match and flag != false_lit;
+                    clause.push_back(SatSolver::negate(flag));
+                }
+
+            if(can_match)
+                solver.add_clause(std::move(clause));
+            continue;
+        }
+
+        if(pkg_dep.use_dependencies.empty())
+        {
+            candidates.push_back(selected);
+            continue;
+        }
+
+        // picking this ebuild implies the flag states asked for
+        Lit choice = new_aux_lit();
+        solver.add_clause({SatSolver::negate(choice), selected});
+
+        for(const auto& use_dep: pkg_dep.use_dependencies)
+        {
+            if(use_dep.type == UseflagDependency::Type::DIRECT)
+            {
+                solver.add_clause({SatSolver::negate(choice),
+                                   usedep_lit(constraint.pkg_id, ebuild.get_id(), use_dep, use_dep.direct_dep.state)});
+                continue;
+            }
+
+            // e.g. [flag?], [!flag?], [flag=] and [!flag=]: depends on the flag state of the ebuild that depends
+            const auto& cond_dep = use_dep.cond_dep;
+            Lit parent_flag = flag_lit(pkg_id, ebuild_id, use_dep.flag_id, true);
+
+            if(cond_dep.forward_if_set)
+                solver.add_clause({SatSolver::negate(choice), SatSolver::negate(parent_flag),
+                                   usedep_lit(constraint.pkg_id, ebuild.get_id(), use_dep, not cond_dep.forward_reverse_state)});
+
+            if(cond_dep.forward_if_not_set)
+                solver.add_clause({SatSolver::negate(choice), parent_flag,
+                                   usedep_lit(constraint.pkg_id, ebuild.get_id(), use_dep, cond_dep.forward_reverse_state)});
+        }
+
+        candidates.push_back(choice);
+    }
+
+    if(not blocker)
+    {
+        candidates.push_back(SatSolver::negate(condition));
+        solver.add_clause(std::move(candidates));
+    }
+}
+
+Resolver::Lit Resolver::ebuild_lit(PackageID pkg_id, EbuildID ebuild_id)
+{
+    const GlobalEbuildID global_id = db->repo.global_ebuild_id(pkg_id, ebuild_id);
+    if(ebuild_vars[global_id] == no_var)
+        encode_package(pkg_id);
+
+    return SatSolver::pos(ebuild_vars[global_id]);
+}
+
+Resolver::Lit Resolver::flag_lit(PackageID pkg_id, EbuildID ebuild_id, FlagID flag_id, bool state)
+{
+    /// \brief literal that is true when the flag of the ebuild is in 'state'
+    /// \note  flags that are not in IUSE_EFFECTIVE are off, as are the flags of the requested atoms
+
+    if(pkg_id == Repo::npos)
+        return state ? false_lit : true_lit;
+
+    FlagState flag_state = db->repo[pkg_id][ebuild_id].get_flag_state(flag_id);
+    if(flag_state == FlagState::NOT_IN_IUSE_EFFECTIVE)
+        return state ? false_lit : true_lit;
+
+    auto key = make_pair(db->repo.global_ebuild_id(pkg_id, ebuild_id), flag_id);
+    auto it = flag_vars.find(key);
+    if(it == flag_vars.end())
+    {
+        bool active = flag_state == FlagState::ON or flag_state == FlagState::FORCED;
+        bool enforced = flag_state == FlagState::FORCED or flag_state == FlagState::MASKED;
+
+        SatSolver::Var var = solver.new_var(active);
+        if(enforced or not allow_use_changes)
+            solver.add_clause({active ? SatSolver::pos(var) : SatSolver::neg(var)});
+
+        it = flag_vars.emplace(key, var).first;
+    }
+
+    return state ? SatSolver::pos(it->second) : SatSolver::neg(it->second);
+}
+
+Resolver::Lit Resolver::usedep_lit(PackageID pkg_id, EbuildID ebuild_id, const UseflagDependency &use_dep, bool state)
+{
+    /// \brief literal that is true when the flag named by 'use_dep' is in 'state' in the ebuild
+    ///        e.g. the fallbacks of [flag(+)] and [flag(-)] when the ebuild doesn't have the flag
+
+    if(db->repo[pkg_id][ebuild_id].get_flag_state(use_dep.flag_id) != FlagState::NOT_IN_IUSE_EFFECTIVE)
+        return flag_lit(pkg_id, ebuild_id, use_dep.flag_id, state);
+
+    if(use_dep.direct_dep.has_default_if_unexisting)
+        return use_dep.direct_dep.default_if_unexisting == state ? true_lit : false_lit;
+
+    return false_lit;
+}
+
+Resolver::Lit Resolver::and_lit(Lit condition, Lit lit)
+{
+    /// \brief literal that is implied by 'condition' and 'lit' being both true
+
+    if(condition == false_lit or lit == false_lit)
+        return false_lit;
+    if(condition == true_lit)
+        return lit;
+    if(lit == true_lit)
+        return condition;
+
+    Lit conjunction = new_aux_lit();
+    solver.add_clause({SatSolver::negate(condition), SatSolver::negate(lit), conjunction});
+    return conjunction;
+}
+
+Resolver::Lit Resolver::new_aux_lit(double activity)
+{
+    return SatSolver::pos(solver.new_var(false, activity));
+}
+
+vector<ResolvedEbuild> Resolver::read_solution()
+{
+    /// \note global IDs follow the package IDs, then the ebuild IDs
+
+    vector<ResolvedEbuild> resolved_ebuilds;
+    for(GlobalEbuildID global_id = 0 ; global_id < ebuild_vars.size() ; global_id++)
+    {
+        if(ebuild_vars[global_id] == no_var or not solver.value(ebuild_vars[global_id]))
+            continue;
+
+        auto [pkg_id, ebuild_id] = db->repo.ebuild_of(global_id);
+        Ebuild &ebuild = db->repo[pkg_id][ebuild_id];
+        ResolvedEbuild resolved = {pkg_id, ebuild_id, ebuild.get_active_flags()};
+
+        // the flags the solver had a say on
+        for(auto it = flag_vars.lower_bound(make_pair(global_id, FlagID(0))) ;
+            it != flag_vars.end() and it->first.first == global_id ; it++)
+        {
+            LocalFlagIndex::LocalFlagID local_id = ebuild.get_flag_index().find(it->first.second);
+            if(solver.value(it->second))
+                resolved.active_flags.insert(local_id);
+            else resolved.active_flags.erase(local_id);
+        }
+
+        resolved.up_to_date = ebuild.is_installed() and resolved.active_flags == ebuild.get_install_active_flags();
+        resolved_ebuilds.push_back(std::move(resolved));
+    }
 
+    return resolved_ebuilds;
 }
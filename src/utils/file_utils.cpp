@@ -1,8 +1,24 @@
 #include "quantum-resolver/utils/file_utils.h"
 #include "quantum-resolver/utils/string_utils.h"
+#include "quantum-resolver/utils/io_uring.h"
+#include "quantum-resolver/utils/thread_utils.h"
 
+#include <cstdlib>
 #include <fstream>
+#include <memory>
 #include <iostream>
+#include <utility>
+#include <algorithm>
+#include <system_error>
+#include <cerrno>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 namespace fs = filesystem;
@@ -30,6 +46,25 @@ vector<fs::path> get_regular_files(const fs::path &path)
     return regular_files;
 }
 
+vector<fs::path> get_subdirectories(const fs::path &path)
+{
+    vector<fs::path> subdirectories;
+    if(fs::is_directory(path))
+        for(const auto &entry: fs::directory_iterator(path))
+            if(entry.is_directory())
+                subdirectories.push_back(entry.path());
+
+    ranges::sort(subdirectories);
+    return subdirectories;
+}
+
+int64_t get_mtime(const fs::path &path)
+{
+    error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    return ec ? 0 : int64_t(mtime.time_since_epoch().count());
+}
+
 vector<string> read_file_lines(const filesystem::path& file_path)
 {
     /* Reads the lines of the file referenced by file_path
@@ -56,6 +91,341 @@ vector<string> read_file_lines(const filesystem::path& file_path)
     return file_lines;
 }
 
+/// \brief read_file_contents(), except that a file that can't be opened gives false
+static bool try_read_file_contents(const filesystem::path& file_path, string& contents)
+{
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw runtime_error("Couldn't stat file " + file_path.string());
+    }
+
+    contents.resize(size_t(file_stat.st_size));
+
+    size_t read_size = 0;
+    while(read_size < contents.size())
+    {
+        ssize_t res = pread(fd, contents.data() + read_size, contents.size() - read_size, off_t(read_size));
+        if(res < 0 and errno == EINTR)
+            continue;
+        if(res <= 0)
+        {
+            close(fd);
+            throw runtime_error("Couldn't read file " + file_path.string());
+        }
+        read_size += size_t(res);
+    }
+
+    close(fd);
+    return true;
+}
+
+void read_file_contents(const filesystem::path& file_path, string& contents)
+{
+    if(not try_read_file_contents(file_path, contents))
+        throw runtime_error("Couldn't open file " + file_path.string());
+}
+
+static size_t file_descriptors_limit()
+{
+    // a batch of read_files() and the other threads reading at the same time
+    constexpr size_t descriptors_num = 1024;
+
+    rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 and limit.rlim_cur != RLIM_INFINITY)
+        return min<size_t>(descriptors_num, limit.rlim_cur);
+    return descriptors_num;
+}
+
+void reserve_file_descriptors()
+{
+    static once_flag reserved;
+    call_once(reserved, []()
+    {
+        const size_t count = file_descriptors_limit();
+
+        // the table grows to hold the highest descriptor, and never shrinks back
+        int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            return;
+
+        int high_fd = fcntl(fd, F_DUPFD_CLOEXEC, int(count) - 1);
+        if(high_fd >= 0)
+            close(high_fd);
+        close(fd);
+    });
+}
+
+/// \brief descriptors the io_uring batches of every thread may keep open at once: half of the
+///        soft limit, the other half is left to the rest of the process (its own files, the rings,
+///        the files read the usual way next to the batches...)
+class DescriptorBudget
+{
+public:
+    DescriptorBudget() : available(max<size_t>(1, file_descriptors_limit() / 2)) {}
+
+    /// \brief waits until some descriptors are available
+    /// \return how many of the 'wanted' ones can be opened, at least one
+    size_t acquire(size_t wanted)
+    {
+        unique_lock lock(mutex);
+        released.wait(lock, [this]{ return available != 0; });
+
+        const size_t count = min(wanted, available);
+        available -= count;
+        return count;
+    }
+
+    void release(size_t count)
+    {
+        {
+            scoped_lock lock(mutex);
+            available += count;
+        }
+        released.notify_all();
+    }
+
+protected:
+    std::mutex mutex;
+    condition_variable released;
+    size_t available;
+};
+
+static DescriptorBudget& get_descriptor_budget()
+{
+    static DescriptorBudget budget;
+    return budget;
+}
+
+static constexpr size_t io_uring_batch_size = 512;
+
+static IoUring* get_thread_ring(bool drop = false)
+{
+    // kept for the next calls, a ring's worker threads outlive each call
+    thread_local unique_ptr<IoUring> ring;
+    thread_local bool dropped = false;
+
+    if(drop)
+    {
+        ring.reset();
+        dropped = true;
+    }
+    else if(not ring and not dropped)
+        ring = make_unique<IoUring>(io_uring_batch_size, initializer_list<uint8_t>{IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE});
+
+    if(not ring or not ring->valid() or ring->capacity() < io_uring_batch_size)
+        return nullptr;
+    return ring.get();
+}
+
+bool io_uring_reads_available()
+{
+    return get_thread_ring() != nullptr;
+}
+
+static bool read_files_with_io_uring(const vector<fs::path>& paths,
+                                     const function<void(size_t, string_view)>& on_read,
+                                     Executor *executor)
+{
+    /// \brief each batch goes through the ring in three rounds: open, read, close.
+    ///        The buffers of a batch are then handed to 'on_read', by the workers of 'executor' if any
+    /// \note  files are read into fixed size buffers rather than statx-ed first: the kernel
+    ///        always hands statx to its worker threads, which costs more than the reads themselves
+    /// \note  a batch holds as many descriptors as the DescriptorBudget gives it, and the files it
+    ///        fails to open for any other reason than being missing (EMFILE...) are read the usual way
+    /// \return false if io_uring can't be used, nothing has been read then
+
+    // md5-cache entries and USE files fit, bigger files are read again the usual way
+    constexpr size_t buffer_size = 1 << 14;
+
+    IoUring *ring = get_thread_ring();
+    if(not ring)
+        return false;
+
+    // a whole batch of descriptors is open at once
+    reserve_file_descriptors();
+    DescriptorBudget &budget = get_descriptor_budget();
+
+    // left uninitialized, the reads fill what gets looked at
+    const size_t buffers_num = min(io_uring_batch_size, paths.size());
+    unique_ptr<char[]> buffers(new char[buffers_num * buffer_size]);
+    vector<int> fds(buffers_num), read_sizes(buffers_num);
+    vector<bool> opened(buffers_num);
+
+    for(size_t begin = 0, count = 0 ; begin < paths.size() ; begin += count)
+    {
+        count = budget.acquire(min(buffers_num, paths.size() - begin));
+
+        // user_data: index in the batch
+        enum struct Round {OPEN, READ, CLOSE} round = Round::OPEN;
+        auto on_completion = [&](uint64_t user_data, int res)
+        {
+            if(round == Round::OPEN)
+            {
+                fds[user_data] = res;
+                opened[user_data] = res >= 0;
+            }
+            else if(round == Round::READ)
+                read_sizes[user_data] = res;
+            else opened[user_data] = false;
+        };
+
+        try
+        {
+            for(size_t i = 0 ; i < count ; i++)
+            {
+                fds[i] = read_sizes[i] = -1;
+                opened[i] = false;
+
+                io_uring_sqe *open_sqe = ring->get_sqe();
+                open_sqe->opcode = IORING_OP_OPENAT;
+                open_sqe->fd = AT_FDCWD;
+                open_sqe->addr = reinterpret_cast<uint64_t>(paths[begin + i].c_str());
+                open_sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                open_sqe->user_data = i;
+            }
+
+            ring->submit_and_wait(unsigned(count));
+            ring->for_each_completion(on_completion);
+
+            round = Round::READ;
+            unsigned reads = 0;
+            for(size_t i = 0 ; i < count ; i++)
+            {
+                if(not opened[i])
+                    continue;
+
+                io_uring_sqe *read_sqe = ring->get_sqe();
+                read_sqe->opcode = IORING_OP_READ;
+                read_sqe->fd = fds[i];
+                read_sqe->addr = reinterpret_cast<uint64_t>(buffers.get() + i * buffer_size);
+                read_sqe->len = unsigned(buffer_size);
+                read_sqe->off = 0;
+                read_sqe->user_data = i;
+                reads++;
+            }
+
+            ring->submit_and_wait(reads);
+            ring->for_each_completion(on_completion);
+
+            round = Round::CLOSE;
+            unsigned closes = 0;
+            for(size_t i = 0 ; i < count ; i++)
+            {
+                if(not opened[i])
+                    continue;
+
+                io_uring_sqe *close_sqe = ring->get_sqe();
+                close_sqe->opcode = IORING_OP_CLOSE;
+                close_sqe->fd = fds[i];
+                close_sqe->user_data = i;
+                closes++;
+            }
+
+            ring->submit_and_wait(closes);
+            ring->for_each_completion(on_completion);
+        }
+        catch(...)
+        {
+            // what the kernel took completes first, so that no descriptor gets opened or closed
+            // behind our back, then the ones still open are closed here. A ring that can't even
+            // be drained is dropped: the next calls read the usual way
+            try
+            {
+                ring->drain(on_completion);
+            }
+            catch(...)
+            {
+                get_thread_ring(true);
+            }
+
+            for(size_t i = 0 ; i < count ; i++)
+                if(opened[i])
+                    close(fds[i]);
+
+            budget.release(count);
+            throw;
+        }
+
+        budget.release(count);
+
+        auto hand_over = [&](size_t i)
+        {
+            // the only failure that means the file isn't there
+            if(fds[i] == -ENOENT)
+                return;
+
+            if(read_sizes[i] >= 0 and size_t(read_sizes[i]) < buffer_size)
+            {
+                on_read(begin + i, string_view(buffers.get() + i * buffer_size, size_t(read_sizes[i])));
+                return;
+            }
+
+            // a full buffer may not hold the whole file, and an open or a read can fail for
+            // lack of resources (EMFILE, ENFILE, EAGAIN...): read it the usual way
+            thread_local string contents;
+            if(try_read_file_contents(paths[begin + i], contents))
+                on_read(begin + i, string_view(contents));
+        };
+
+        if(executor)
+            executor->parallel_for(count, hand_over);
+        else for(size_t i = 0 ; i < count ; i++)
+            hand_over(i);
+    }
+
+    return true;
+}
+
+void read_files(const vector<fs::path>& paths, const function<void(size_t, string_view)>& on_read, Executor &executor)
+{
+    // a ring isn't worth setting up for a handful of files
+    if(paths.size() >= 64 and read_files_with_io_uring(paths, on_read, &executor))
+        return;
+
+    executor.parallel_for(paths.size(), [&](size_t i)
+    {
+        thread_local string contents;
+        if(try_read_file_contents(paths[i], contents))
+            on_read(i, string_view(contents));
+    });
+}
+
+void read_files_in_order(const vector<fs::path>& paths, const function<void(size_t, string_view)>& on_read)
+{
+    if(paths.size() >= 64 and read_files_with_io_uring(paths, on_read, nullptr))
+        return;
+
+    string contents;
+    for(size_t i = 0 ; i < paths.size() ; i++)
+        if(try_read_file_contents(paths[i], contents))
+            on_read(i, string_view(contents));
+}
+
+vector<string_view> get_lines(string_view contents)
+{
+    vector<string_view> lines;
+    while(not contents.empty())
+    {
+        size_t line_end = min(contents.find('\n'), contents.size());
+        string_view line = contents.substr(0, line_end);
+        contents.remove_prefix(min(line_end + 1, contents.size()));
+
+        skim_spaces_at_the_edges(line);
+        if(line.starts_with("#") or line.empty())
+            continue;
+
+        lines.push_back(line);
+    }
+
+    return lines;
+}
+
 template <bool quoted, class... StartWithContiner> requires (sizeof...(StartWithContiner) == 0 or
                                                               (sizeof...(StartWithContiner) == 1 and
                                                                  (std::is_same_v<StartWithContiner, vector<string>> and ...)))
@@ -139,15 +509,197 @@ vector<pair<string, string>> read_unquoted_vars(const filesystem::path& file_pat
     return read_vars<false>(file_path);
 }
 
+RawVars::RawVars(const fs::path& file_path, const vector<string>& names)
+{
+    // the file goes in a buffer that is reused by the calls made from the same thread,
+    // only the wanted variables get copied in 'buffer'
+    thread_local string contents;
+    read_file_contents(file_path, contents);
+
+    *this = RawVars(string_view(contents), names);
+}
+
+RawVars::RawVars(string_view contents, const vector<string>& names)
+{
+    vector<pair<string_view, string_view>> found_vars;
+    size_t found_size = 0;
+
+    string_view rest(contents);
+    while(not rest.empty())
+    {
+        size_t line_end = min(rest.find('\n'), rest.size());
+        string_view line = rest.substr(0, line_end);
+        rest.remove_prefix(min(line_end + 1, rest.size()));
+
+        skim_spaces_at_the_edges(line);
+        if(line.starts_with("#") or line.empty())
+            continue;
+
+        size_t eq_sign_pos = line.find('=');
+        if(eq_sign_pos == string_view::npos)
+            continue;
+
+        string_view name = line.substr(0, eq_sign_pos);
+        if(ranges::find(names, name) == names.end())
+            continue;
+
+        found_vars.emplace_back(name, line.substr(eq_sign_pos + 1));
+        found_size += line.size() - 1;
+    }
+
+    buffer.reserve(found_size);
+    vars.reserve(found_vars.size());
+    for(const auto& [name, value]: found_vars)
+        add(name, value);
+}
+
+void RawVars::add(string_view name, string_view value)
+{
+    vars.push_back({uint32_t(buffer.size()), uint32_t(name.size()),
+                    uint32_t(buffer.size() + name.size()), uint32_t(value.size())});
+    buffer += name;
+    buffer += value;
+}
+
+bool RawVars::contains(string_view name) const
+{
+    return ranges::any_of(vars, [this, &name](const Var& var){
+        return string_view(buffer).substr(var.name_start, var.name_size) == name;
+    });
+}
+
+string_view RawVars::operator [](string_view name) const
+{
+    for(const Var& var: vars)
+        if(string_view(buffer).substr(var.name_start, var.name_size) == name)
+            return string_view(buffer).substr(var.value_start, var.value_size);
+
+    return string_view();
+}
+
+void RawVars::clear()
+{
+    buffer.clear();
+    buffer.shrink_to_fit();
+    vars.clear();
+    vars.shrink_to_fit();
+}
+
+MappedFile::MappedFile(const fs::path& file_path)
+{
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw runtime_error("Couldn't open file " + file_path.string());
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw runtime_error("Couldn't stat file " + file_path.string());
+    }
+
+    if(file_stat.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw runtime_error("Couldn't map file " + file_path.string());
+        }
+        data = static_cast<const char*>(mapping);
+        size = size_t(file_stat.st_size);
+    }
+
+    // the mapping stays valid after closing the descriptor
+    close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0))
+{
+}
+
+MappedFile& MappedFile::operator = (MappedFile&& other) noexcept
+{
+    if(this != &other)
+    {
+        unmap();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+void MappedFile::unmap()
+{
+    if(data != nullptr)
+        munmap(const_cast<char*>(data), size);
+
+    data = nullptr;
+    size = 0;
+}
+
+void write_file_atomically(const fs::path& file_path, string_view content)
+{
+    fs::path tmp_path = file_path;
+    tmp_path += ".tmp";
+
+    {
+        fstream file(tmp_path, ios::out | ios::binary | ios::trunc);
+        if(not file.is_open())
+            throw runtime_error("Couldn't open file " + tmp_path.string() + " for writing");
+
+        file.write(content.data(), streamsize(content.size()));
+        if(not file.good())
+            throw runtime_error("Couldn't write to file " + tmp_path.string());
+    }
+
+    fs::rename(tmp_path, file_path);
+}
+
+MemoryUsage read_memory_usage()
+{
+    MemoryUsage usage;
+
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line))
+    {
+        // e.g. "VmRSS:\t  123456 kB"
+        size_t *field = line.starts_with("VmRSS:") ? &usage.resident_kb :
+                        line.starts_with("VmHWM:") ? &usage.peak_resident_kb : nullptr;
+        if(field != nullptr)
+            *field = stoul(line.substr(line.find(':') + 1));
+    }
+
+    return usage;
+}
+
+fs::path rooted_path(const fs::path &path)
+{
+    const char* root = getenv("QUANTUM_ROOT");
+    if(root == nullptr or *root == '\0')
+        return path;
+
+    return fs::path(root) / path.relative_path();
+}
+
 vector<fs::path> get_profiles_tree()
 {
-    vector<fs::path> profile_tree = {"/etc/portage/profile", "/etc/portage"};
+    vector<fs::path> profile_tree = {rooted_path("/etc/portage/profile"), rooted_path("/etc/portage")};
 
-    fs::path profile_symlink("/etc/portage/make.profile");
+    fs::path profile_symlink = rooted_path("/etc/portage/make.profile");
     if(not fs::is_symlink(profile_symlink))
-        throw runtime_error("/etc/portage/make.profile doesn't exist or isn't a symlink");
+        throw runtime_error(profile_symlink.string() + " doesn't exist or isn't a symlink");
 
-    fs::path profile = fs::canonical(profile_symlink);
+    // an absolute target is a path of the system too
+    fs::path profile_target = fs::read_symlink(profile_symlink);
+    fs::path profile = fs::canonical(profile_target.is_absolute() ? rooted_path(profile_target) : profile_symlink);
 
     vector<fs::path> current_depth_profiles = {profile};
     vector<fs::path> next_depth_profiles;
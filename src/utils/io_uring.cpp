@@ -0,0 +1,178 @@
+#include "quantum-resolver/utils/io_uring.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+IoUring::IoUring(unsigned entries, initializer_list<uint8_t> needed_ops)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // completions are only reaped by the thread that submits, when it waits for them (Linux 6.1),
+    // which spares the kernel from interrupting it
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    int fd = int(syscall(__NR_io_uring_setup, entries, &params));
+    if(fd < 0)
+    {
+        memset(&params, 0, sizeof(params));
+        fd = int(syscall(__NR_io_uring_setup, entries, &params));
+    }
+    if(fd < 0)
+        return;
+
+    // the probe tells which operations this kernel knows of
+    if(needed_ops.size() != 0)
+    {
+        constexpr unsigned probed_ops = 256;
+        vector<char> probe_buffer(sizeof(io_uring_probe) + probed_ops * sizeof(io_uring_probe_op), 0);
+        auto *probe = reinterpret_cast<io_uring_probe*>(probe_buffer.data());
+
+        if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, probed_ops) < 0)
+        {
+            close(fd);
+            return;
+        }
+
+        for(uint8_t op: needed_ops)
+            if(op > probe->last_op or not (probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            {
+                close(fd);
+                return;
+            }
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // both rings share one mapping since Linux 5.4
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mmap)
+        sq_ring_size = cq_ring_size = max(sq_ring_size, cq_ring_size);
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(sq_ring == MAP_FAILED)
+    {
+        sq_ring = nullptr;
+        close(fd);
+        return;
+    }
+
+    if(single_mmap)
+        cq_ring = sq_ring;
+    else
+    {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(cq_ring == MAP_FAILED)
+        {
+            cq_ring = nullptr;
+            munmap(sq_ring, sq_ring_size);
+            sq_ring = nullptr;
+            close(fd);
+            return;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_mapping = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sqes_mapping == MAP_FAILED)
+    {
+        if(cq_ring != sq_ring)
+            munmap(cq_ring, cq_ring_size);
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = cq_ring = nullptr;
+        close(fd);
+        return;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqes_mapping);
+
+    char *sq = static_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    sq_entries = params.sq_entries;
+    ring_fd = fd;
+}
+
+IoUring::~IoUring()
+{
+    if(ring_fd < 0)
+        return;
+
+    munmap(sqes, sqes_size);
+    if(cq_ring != sq_ring)
+        munmap(cq_ring, cq_ring_size);
+    munmap(sq_ring, sq_ring_size);
+    close(ring_fd);
+}
+
+io_uring_sqe* IoUring::get_sqe()
+{
+    const unsigned head = atomic_ref<unsigned>(*sq_head).load(memory_order_acquire);
+    const unsigned tail = *sq_tail + queued;
+    if(tail - head >= sq_entries)
+        return nullptr;
+
+    const unsigned index = tail & *sq_mask;
+    sq_array[index] = index;
+    queued++;
+
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    return sqe;
+}
+
+void IoUring::submit_and_wait(unsigned wait_count)
+{
+    // the kernel sees the new entries once the tail moves
+    atomic_ref<unsigned>(*sq_tail).store(*sq_tail + queued, memory_order_release);
+    unsigned to_submit = queued;
+    queued = 0;
+
+    while(to_submit != 0 or wait_count != 0)
+    {
+        long res = syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_count,
+                           wait_count != 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if(res < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw runtime_error(string("io_uring_enter() failed: ") + strerror(errno));
+        }
+
+        if(res == 0 and to_submit != 0)
+            throw runtime_error("io_uring_enter() did not take any entry");
+
+        to_submit -= unsigned(res);
+        in_flight += unsigned(res);
+
+        // everything is submitted: the wait has been done by this call
+        if(to_submit == 0)
+            break;
+    }
+}
+
+void IoUring::discard_unsubmitted()
+{
+    // without SQPOLL the kernel only reads the submission ring during io_uring_enter(): what it
+    // has not consumed up to the head can be taken back by moving the tail
+    const unsigned head = atomic_ref<unsigned>(*sq_head).load(memory_order_acquire);
+    atomic_ref<unsigned>(*sq_tail).store(head, memory_order_release);
+    queued = 0;
+}
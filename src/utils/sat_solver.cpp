@@ -0,0 +1,525 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "quantum-resolver/utils/sat_solver.h"
+
+using namespace std;
+
+static constexpr SatSolver::Lit no_lit = numeric_limits<SatSolver::Lit>::max();
+
+SatSolver::Var SatSolver::new_var(bool preferred_state, double initial_activity)
+{
+    Var var = Var(assigns.size());
+
+    assigns.push_back(Value::UNASSIGNED);
+    saved_phase.push_back(preferred_state);
+    levels.push_back(0);
+    reasons.push_back(no_reason);
+    activity.push_back(initial_activity);
+    heap_index.push_back(npos);
+    seen.push_back(false);
+
+    watches.emplace_back();
+    watches.emplace_back();
+
+    heap_insert(var);
+    return var;
+}
+
+void SatSolver::add_clause(std::vector<Lit> lits)
+{
+    assert(decision_level() == 0);
+    if(not ok)
+        return;
+
+    // x and ~x end up next to each other
+    ranges::sort(lits);
+    lits.erase(unique(lits.begin(), lits.end()), lits.end());
+
+    size_t kept = 0;
+    for(size_t i = 0 ; i < lits.size() ; i++)
+    {
+        if(value_lit(lits[i]) == Value::TRUE or (i + 1 < lits.size() and lits[i + 1] == negate(lits[i])))
+            return; // satisfied or tautology
+
+        if(value_lit(lits[i]) == Value::UNASSIGNED)
+            lits[kept++] = lits[i];
+    }
+    lits.resize(kept);
+
+    if(lits.empty())
+        ok = false;
+    else if(lits.size() == 1)
+        enqueue(lits[0], no_reason);
+    else attach_clause(std::move(lits), false);
+}
+
+void SatSolver::add_at_most_one(const std::vector<Lit> &lits)
+{
+    if(lits.size() <= 6)
+    {
+        for(size_t i = 0 ; i < lits.size() ; i++)
+            for(size_t j = i + 1 ; j < lits.size() ; j++)
+                add_clause({negate(lits[i]), negate(lits[j])});
+        return;
+    }
+
+    // sequential counter encoding: counter[i] is true if one of lits[0..i] is true
+    vector<Lit> counter;
+    for(size_t i = 0 ; i + 1 < lits.size() ; i++)
+        counter.push_back(pos(new_var()));
+
+    for(size_t i = 0 ; i < lits.size() ; i++)
+    {
+        if(i + 1 < lits.size())
+            add_clause({negate(lits[i]), counter[i]});
+
+        if(i > 0)
+        {
+            add_clause({negate(lits[i]), negate(counter[i - 1])});
+            if(i + 1 < lits.size())
+                add_clause({negate(counter[i - 1]), counter[i]});
+        }
+    }
+}
+
+SatSolver::Value SatSolver::value_lit(Lit lit) const
+{
+    Value value = assigns[var_of(lit)];
+    if(value == Value::UNASSIGNED or not is_negated(lit))
+        return value;
+    else return value == Value::TRUE ? Value::FALSE : Value::TRUE;
+}
+
+SatSolver::ClauseRef SatSolver::attach_clause(std::vector<Lit> lits, bool learnt)
+{
+    ClauseRef ref = ClauseRef(clauses.size());
+
+    watches[negate(lits[0])].push_back({ref, lits[1]});
+    watches[negate(lits[1])].push_back({ref, lits[0]});
+
+    clauses.push_back({std::move(lits), learnt, 0});
+    return ref;
+}
+
+void SatSolver::enqueue(Lit lit, ClauseRef reason)
+{
+    Var var = var_of(lit);
+    assigns[var] = is_negated(lit) ? Value::FALSE : Value::TRUE;
+    levels[var] = decision_level();
+    reasons[var] = reason;
+    trail.push_back(lit);
+}
+
+SatSolver::ClauseRef SatSolver::propagate()
+{
+    /// \brief assigns the literals implied by the ones on the trail
+    /// \return the clause that became false, no_reason if there is none
+
+    ClauseRef conflict = no_reason;
+
+    while(propagation_head < trail.size() and conflict == no_reason)
+    {
+        Lit true_lit = trail[propagation_head++];
+        Lit false_lit = negate(true_lit);
+        stats.propagations++;
+
+        vector<Watcher> &lit_watches = watches[true_lit];
+        size_t i = 0, j = 0;
+        while(i < lit_watches.size())
+        {
+            Watcher watcher = lit_watches[i++];
+            if(value_lit(watcher.blocker) == Value::TRUE)
+            {
+                lit_watches[j++] = watcher;
+                continue;
+            }
+
+            // make sure the false literal is lits[1]
+            vector<Lit> &lits = clauses[watcher.clause].lits;
+            if(lits[0] == false_lit)
+                swap(lits[0], lits[1]);
+
+            Watcher new_watcher = {watcher.clause, lits[0]};
+            if(lits[0] != watcher.blocker and value_lit(lits[0]) == Value::TRUE)
+            {
+                lit_watches[j++] = new_watcher;
+                continue;
+            }
+
+            // look for another literal to watch
+            bool found_watch = false;
+            for(size_t k = 2 ; k < lits.size() ; k++)
+                if(value_lit(lits[k]) != Value::FALSE)
+                {
+                    swap(lits[1], lits[k]);
+                    watches[negate(lits[1])].push_back(new_watcher);
+                    found_watch = true;
+                    break;
+                }
+
+            if(found_watch)
+                continue;
+
+            // the clause is unit or false
+            lit_watches[j++] = new_watcher;
+            if(value_lit(lits[0]) == Value::FALSE)
+            {
+                conflict = watcher.clause;
+                while(i < lit_watches.size())
+                    lit_watches[j++] = lit_watches[i++];
+            }
+            else enqueue(lits[0], watcher.clause);
+        }
+        lit_watches.resize(j);
+    }
+
+    return conflict;
+}
+
+void SatSolver::analyze(ClauseRef conflict, std::vector<Lit> &learnt, int &backtrack_level, uint32_t &lbd)
+{
+    /// \brief first unique implication point learning: walks back the trail from the
+    ///        conflict until a single literal of the current decision level remains
+    /// \note  learnt[0] is the literal that gets asserted after backtracking
+
+    learnt.assign(1, no_lit);
+
+    int current_level_lits = 0;
+    Lit implied_lit = no_lit;
+    size_t trail_index = trail.size();
+    ClauseRef clause_ref = conflict;
+
+    do
+    {
+        const vector<Lit> &lits = clauses[clause_ref].lits;
+
+        // lits[0] of a reason clause is the literal it implied
+        for(size_t k = (implied_lit == no_lit ? 0 : 1) ; k < lits.size() ; k++)
+        {
+            Var var = var_of(lits[k]);
+            if(seen[var] or levels[var] == 0)
+                continue;
+
+            seen[var] = true;
+            bump_var(var);
+
+            if(levels[var] >= decision_level())
+                current_level_lits++;
+            else learnt.push_back(lits[k]);
+        }
+
+        while(not seen[var_of(trail[--trail_index])]);
+
+        implied_lit = trail[trail_index];
+        clause_ref = reasons[var_of(implied_lit)];
+        seen[var_of(implied_lit)] = false;
+        current_level_lits--;
+    }
+    while(current_level_lits > 0);
+
+    learnt[0] = negate(implied_lit);
+
+    // drop the literals implied by the other ones
+    const vector<Lit> analyzed_lits = learnt;
+    learnt.erase(remove_if(learnt.begin() + 1, learnt.end(), [this](Lit lit){ return redundant(lit); }), learnt.end());
+
+    for(Lit lit: analyzed_lits)
+        seen[var_of(lit)] = false;
+
+    // the highest level among the other literals goes to learnt[1], to be watched
+    backtrack_level = 0;
+    for(size_t k = 1 ; k < learnt.size() ; k++)
+        if(levels[var_of(learnt[k])] > backtrack_level)
+        {
+            backtrack_level = levels[var_of(learnt[k])];
+            swap(learnt[1], learnt[k]);
+        }
+
+    vector<int> clause_levels;
+    for(Lit lit: learnt)
+        clause_levels.push_back(levels[var_of(lit)]);
+    ranges::sort(clause_levels);
+    lbd = uint32_t(unique(clause_levels.begin(), clause_levels.end()) - clause_levels.begin());
+}
+
+bool SatSolver::redundant(Lit lit) const
+{
+    /// \brief true if every other literal of the clause that implied 'lit' is already in the learnt clause
+
+    ClauseRef reason = reasons[var_of(lit)];
+    if(reason == no_reason)
+        return false;
+
+    const vector<Lit> &lits = clauses[reason].lits;
+    for(size_t k = 1 ; k < lits.size() ; k++)
+        if(not seen[var_of(lits[k])] and levels[var_of(lits[k])] > 0)
+            return false;
+
+    return true;
+}
+
+void SatSolver::backtrack(int level)
+{
+    if(decision_level() <= level)
+        return;
+
+    for(size_t i = trail.size() ; i > trail_limits[level] ; i--)
+    {
+        Lit lit = trail[i - 1];
+        Var var = var_of(lit);
+
+        assigns[var] = Value::UNASSIGNED;
+        reasons[var] = no_reason;
+        saved_phase[var] = not is_negated(lit);
+
+        if(not heap_contains(var))
+            heap_insert(var);
+    }
+
+    trail.resize(trail_limits[level]);
+    trail_limits.resize(level);
+    propagation_head = trail.size();
+}
+
+SatSolver::Lit SatSolver::pick_branch_lit()
+{
+    while(not heap.empty())
+    {
+        Var var = heap_pop();
+        if(assigns[var] == Value::UNASSIGNED)
+            return saved_phase[var] ? pos(var) : neg(var);
+    }
+
+    return no_lit;
+}
+
+void SatSolver::reduce_learnts()
+{
+    /// \brief forgets half of the learnt clauses, the ones spanning the most decision levels first
+    /// \note  only called at decision level 0, where no clause is the reason of an assignment
+    ///        that matters, clauses satisfied at level 0 are removed as well
+
+    assert(decision_level() == 0);
+
+    vector<ClauseRef> learnt_refs;
+    for(ClauseRef ref = 0 ; ref < clauses.size() ; ref++)
+        if(clauses[ref].learnt and clauses[ref].lbd > 2)
+            learnt_refs.push_back(ref);
+
+    ranges::sort(learnt_refs, [this](ClauseRef a, ClauseRef b)
+    {
+        if(clauses[a].lbd != clauses[b].lbd)
+            return clauses[a].lbd > clauses[b].lbd;
+        return clauses[a].lits.size() > clauses[b].lits.size();
+    });
+
+    vector<bool> removed(clauses.size(), false);
+    for(size_t i = 0 ; i < learnt_refs.size() / 2 ; i++)
+        removed[learnt_refs[i]] = true;
+
+    for(ClauseRef ref = 0 ; ref < clauses.size() ; ref++)
+        if(ranges::any_of(clauses[ref].lits, [this](Lit lit){ return value_lit(lit) == Value::TRUE; }))
+            removed[ref] = true;
+
+    vector<Clause> kept_clauses;
+    learnts_count = 0;
+    for(ClauseRef ref = 0 ; ref < clauses.size() ; ref++)
+        if(not removed[ref])
+        {
+            learnts_count += clauses[ref].learnt;
+            kept_clauses.push_back(std::move(clauses[ref]));
+        }
+
+    clauses = std::move(kept_clauses);
+
+    for(Lit lit: trail)
+        reasons[var_of(lit)] = no_reason;
+
+    rebuild_watches();
+}
+
+void SatSolver::rebuild_watches()
+{
+    for(auto &lit_watches: watches)
+        lit_watches.clear();
+
+    for(ClauseRef ref = 0 ; ref < clauses.size() ; ref++)
+    {
+        const vector<Lit> &lits = clauses[ref].lits;
+        watches[negate(lits[0])].push_back({ref, lits[1]});
+        watches[negate(lits[1])].push_back({ref, lits[0]});
+    }
+}
+
+void SatSolver::bump_var(Var var)
+{
+    activity[var] += var_increment;
+    if(activity[var] > 1e100)
+    {
+        for(double &var_activity: activity)
+            var_activity *= 1e-100;
+        var_increment *= 1e-100;
+    }
+
+    if(heap_contains(var))
+        heap_sift_up(heap_index[var]);
+}
+
+void SatSolver::heap_insert(Var var)
+{
+    heap_index[var] = heap.size();
+    heap.push_back(var);
+    heap_sift_up(heap.size() - 1);
+}
+
+SatSolver::Var SatSolver::heap_pop()
+{
+    Var top = heap.front();
+    heap_index[top] = npos;
+
+    heap.front() = heap.back();
+    heap.pop_back();
+    if(not heap.empty())
+    {
+        heap_index[heap.front()] = 0;
+        heap_sift_down(0);
+    }
+
+    return top;
+}
+
+void SatSolver::heap_sift_up(std::size_t index)
+{
+    Var var = heap[index];
+    while(index > 0 and activity[heap[(index - 1) / 2]] < activity[var])
+    {
+        heap[index] = heap[(index - 1) / 2];
+        heap_index[heap[index]] = index;
+        index = (index - 1) / 2;
+    }
+
+    heap[index] = var;
+    heap_index[var] = index;
+}
+
+void SatSolver::heap_sift_down(std::size_t index)
+{
+    Var var = heap[index];
+    while(2 * index + 1 < heap.size())
+    {
+        size_t child = 2 * index + 1;
+        if(child + 1 < heap.size() and activity[heap[child + 1]] > activity[heap[child]])
+            child++;
+
+        if(activity[heap[child]] <= activity[var])
+            break;
+
+        heap[index] = heap[child];
+        heap_index[heap[index]] = index;
+        index = child;
+    }
+
+    heap[index] = var;
+    heap_index[var] = index;
+}
+
+double SatSolver::luby(double y, std::uint64_t x)
+{
+    /// \brief x-th element of the Luby sequence 1 1 2 1 1 2 4 1 1 2 ... with 'y' instead of 2
+
+    uint64_t size = 1;
+    int seq = 0;
+    while(size < x + 1)
+    {
+        seq++;
+        size = 2 * size + 1;
+    }
+
+    while(size - 1 != x)
+    {
+        size = (size - 1) >> 1;
+        seq--;
+        x = x % size;
+    }
+
+    return pow(y, seq);
+}
+
+SatSolver::Result SatSolver::solve()
+{
+    backtrack(0);
+
+    if(not ok or propagate() != no_reason)
+    {
+        ok = false;
+        return Result::UNSATISFIABLE;
+    }
+
+    vector<Lit> learnt;
+    size_t max_learnts = max<size_t>(clauses.size() / 3, 2000);
+
+    for(uint64_t restart = 0 ; ; restart++)
+    {
+        const uint64_t conflict_budget = uint64_t(luby(2, restart) * 100);
+        uint64_t restart_conflicts = 0;
+
+        while(true)
+        {
+            ClauseRef conflict = propagate();
+            if(conflict != no_reason)
+            {
+                stats.conflicts++;
+                restart_conflicts++;
+
+                if(decision_level() == 0)
+                {
+                    ok = false;
+                    return Result::UNSATISFIABLE;
+                }
+
+                int backtrack_level;
+                uint32_t lbd;
+                analyze(conflict, learnt, backtrack_level, lbd);
+                backtrack(backtrack_level);
+
+                if(learnt.size() == 1)
+                    enqueue(learnt[0], no_reason);
+                else
+                {
+                    ClauseRef ref = attach_clause(learnt, true);
+                    clauses[ref].lbd = lbd;
+                    enqueue(learnt[0], ref);
+
+                    learnts_count++;
+                    stats.learnt_clauses++;
+                }
+
+                decay_activities();
+            }
+            else if(restart_conflicts >= conflict_budget)
+            {
+                backtrack(0);
+                stats.restarts++;
+
+                if(learnts_count >= max_learnts)
+                {
+                    reduce_learnts();
+                    max_learnts += max_learnts / 10;
+                }
+                break;
+            }
+            else
+            {
+                Lit decision = pick_branch_lit();
+                if(decision == no_lit)
+                    return Result::SATISFIABLE; // every variable is assigned
+
+                stats.decisions++;
+                trail_limits.push_back(trail.size());
+                enqueue(decision, no_reason);
+            }
+        }
+    }
+}
@@ -0,0 +1,228 @@
+#include "quantum-resolver/utils/thread_utils.h"
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+
+// the executor the current thread works for, and its queue in there
+thread_local Executor *current_executor = nullptr;
+thread_local size_t current_queue = 0;
+
+} // namespace
+
+size_t worker_count()
+{
+    if(const char* jobs = getenv("QUANTUM_JOBS"); jobs != nullptr and *jobs != '\0')
+    {
+        try
+        {
+            return max<size_t>(1, stoul(jobs));
+        }
+        catch(const exception&)
+        {
+            // not a number: same as unset
+        }
+    }
+
+    return max<size_t>(1, thread::hardware_concurrency());
+}
+
+Executor::Executor(size_t workers_num) : workers_num(max<size_t>(1, workers_num)), owner_pid(getpid())
+{
+    for(size_t i = 0 ; i < this->workers_num ; i++)
+        queues.push_back(make_unique<TaskQueue>());
+
+    // the threads that wait for a group count as the last worker
+    threads.reserve(this->workers_num - 1);
+    for(size_t i = 0 ; i + 1 < this->workers_num ; i++)
+        threads.emplace_back(&Executor::work, this, i);
+}
+
+Executor::~Executor()
+{
+    // a forked child has no thread to join, and the handles of the parent's can't be
+    // destroyed while joinable: they are left behind
+    if(forked())
+    {
+        new vector<thread>(std::move(threads));
+        return;
+    }
+
+    {
+        scoped_lock lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(auto &thread: threads)
+        thread.join();
+}
+
+bool Executor::forked() const
+{
+    return getpid() != owner_pid;
+}
+
+void Executor::push(Task task, Priority priority)
+{
+    // counted first: a thread that sees no task queued is sure to get woken up
+    queued_tasks++;
+
+    TaskQueue &queue = *queues[current_executor == this ? current_queue : queues.size() - 1];
+    {
+        scoped_lock lock(queue.mutex);
+        queue.tasks[size_t(priority)].push_back(std::move(task));
+    }
+
+    {
+        scoped_lock lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+bool Executor::pop(Task &task)
+{
+    const size_t own_queue = current_executor == this ? current_queue : queues.size() - 1;
+
+    for(size_t priority = 0 ; priority < priorities_num ; priority++)
+    {
+        // the newest task of its own queue first: it is the most likely to find its data in cache
+        {
+            TaskQueue &queue = *queues[own_queue];
+            scoped_lock lock(queue.mutex);
+            if(auto &tasks = queue.tasks[priority] ; not tasks.empty())
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                queued_tasks--;
+                return true;
+            }
+        }
+
+        // then the oldest one of the others, which is likely the biggest
+        for(size_t offset = 1 ; offset < queues.size() ; offset++)
+        {
+            TaskQueue &queue = *queues[(own_queue + offset) % queues.size()];
+            scoped_lock lock(queue.mutex);
+            if(auto &tasks = queue.tasks[priority] ; not tasks.empty())
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                queued_tasks--;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool Executor::run_one()
+{
+    Task task;
+    if(not pop(task))
+        return false;
+
+    try
+    {
+        task.func();
+    }
+    catch(...)
+    {
+        task.group->fail(current_exception());
+    }
+
+    // the group can be gone as soon as its count drops to zero
+    if(--task.group->pending == 0)
+    {
+        {
+            scoped_lock lock(sleep_mutex);
+        }
+        wake.notify_all();
+    }
+
+    return true;
+}
+
+void Executor::work(size_t worker_index)
+{
+    current_executor = this;
+    current_queue = worker_index;
+
+    while(true)
+    {
+        if(run_one())
+            continue;
+
+        unique_lock lock(sleep_mutex);
+        wake.wait(lock, [this]{ return queued_tasks != 0 or stopping; });
+        if(stopping and queued_tasks == 0)
+            return;
+    }
+}
+
+Executor::TaskGroup::TaskGroup(Executor &executor, Priority priority) : executor(executor), priority(priority)
+{
+}
+
+Executor::TaskGroup::~TaskGroup()
+{
+    try
+    {
+        wait();
+    }
+    catch(...)
+    {
+    }
+}
+
+void Executor::TaskGroup::run(function<void()> task)
+{
+    // nobody else would run it anyway
+    if(executor.workers_num <= 1 or executor.forked())
+    {
+        try
+        {
+            task();
+        }
+        catch(...)
+        {
+            fail(current_exception());
+        }
+        return;
+    }
+
+    pending++;
+    executor.push(Task{std::move(task), this}, priority);
+}
+
+void Executor::TaskGroup::wait()
+{
+    while(pending != 0)
+    {
+        if(executor.run_one())
+            continue;
+
+        // the last tasks of the group are running on other threads
+        unique_lock lock(executor.sleep_mutex);
+        executor.wake.wait(lock, [this]{ return pending == 0 or executor.queued_tasks != 0; });
+    }
+
+    scoped_lock lock(exception_mutex);
+    if(first_exception)
+        rethrow_exception(exchange(first_exception, nullptr));
+}
+
+void Executor::TaskGroup::fail(exception_ptr exception)
+{
+    scoped_lock lock(exception_mutex);
+    if(not first_exception)
+        first_exception = exception;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "quantum-resolver/utils/dynamic_bitset.h"
+
+using namespace std;
+
+// Checks DynamicBitset against std::set on values around the 64 bits word boundaries, for every
+// operator, intersects(), is_subset_of(), iteration, and the trimming of zero words that keeps
+// equal sets equal
+
+const vector<size_t> boundary_values = {0, 1, 62, 63, 64, 65, 126, 127, 128, 129, 191, 192, 255, 256, 1000};
+
+DynamicBitset to_bitset(const set<size_t> &values)
+{
+    DynamicBitset bitset;
+    for(size_t value: values)
+        bitset.insert(value);
+    return bitset;
+}
+
+string to_string(const set<size_t> &values)
+{
+    string result = "{";
+    for(size_t value: values)
+        result += (result.size() > 1 ? " " : "") + std::to_string(value);
+    return result + "}";
+}
+
+int main()
+{
+    size_t failures = 0;
+    auto check = [&failures](bool result, const string &what)
+    {
+        if(not result)
+        {
+            cout << "FAILED: " << what << endl;
+            failures++;
+        }
+    };
+
+    // same contents, same iteration, same size
+    auto check_equal = [&check](const DynamicBitset &bitset, const set<size_t> &expected, const string &what)
+    {
+        check(vector<size_t>(bitset.begin(), bitset.end()) == vector<size_t>(expected.begin(), expected.end())
+              and bitset.size() == expected.size() and bitset.empty() == expected.empty()
+              and bitset == to_bitset(expected), what + " should be " + to_string(expected));
+    };
+
+    // the last word has to be dropped once it gets empty, whatever way it does
+    DynamicBitset a = to_bitset({63, 128});
+    a.erase(128);
+    check_equal(a, {63}, "{63 128} after erase(128)");
+    a.erase(63);
+    check_equal(a, {}, "{63} after erase(63)");
+    a.erase(5000);
+    check_equal(a, {}, "{} after erase(5000)");
+    check_equal(to_bitset({63, 127}) - to_bitset({127}), {63}, "{63 127} - {127}");
+    check_equal(to_bitset({64, 200}) & to_bitset({64, 199}), {64}, "{64 200} & {64 199}");
+    check_equal(to_bitset({1, 128}) ^ to_bitset({128}), {1}, "{1 128} ^ {128}");
+    check(to_bitset({0, 64}) != to_bitset({0, 64, 128}), "{0 64} != {0 64 128}");
+
+    check(to_bitset({}).is_subset_of(to_bitset({})), "{} is a subset of {}");
+    check(to_bitset({63}).is_subset_of(to_bitset({63, 64})), "{63} is a subset of {63 64}");
+    check(not to_bitset({63, 128}).is_subset_of(to_bitset({63, 64})), "{63 128} is not a subset of {63 64}");
+    check(not to_bitset({64}).is_subset_of(to_bitset({63, 128})), "{64} is not a subset of {63 128}");
+    check(not to_bitset({}).intersects(to_bitset({})), "{} does not intersect {}");
+    check(not to_bitset({63}).intersects(to_bitset({64, 128})), "{63} does not intersect {64 128}");
+    check(to_bitset({0, 128}).intersects(to_bitset({128})), "{0 128} intersects {128}");
+
+    // random sets of boundary values, from a fixed seed
+    mt19937 rng(64);
+    auto random_set = [&rng]()
+    {
+        set<size_t> values;
+        for(size_t value: boundary_values)
+            if(rng() % 3 == 0)
+                values.insert(value);
+        return values;
+    };
+
+    for(size_t i = 0 ; i < 2000 ; i++)
+    {
+        set<size_t> x = random_set(), y = random_set(), expected;
+        DynamicBitset bx = to_bitset(x), by = to_bitset(y);
+        const string names = " of " + to_string(x) + " and " + to_string(y);
+
+        expected.clear();
+        ranges::set_union(x, y, inserter(expected, expected.end()));
+        check_equal(bx + by, expected, "union" + names);
+
+        expected.clear();
+        ranges::set_difference(x, y, inserter(expected, expected.end()));
+        check_equal(bx - by, expected, "difference" + names);
+
+        expected.clear();
+        ranges::set_intersection(x, y, inserter(expected, expected.end()));
+        check_equal(bx & by, expected, "intersection" + names);
+        check(bx.intersects(by) == not expected.empty(), "intersects()" + names);
+
+        expected.clear();
+        ranges::set_symmetric_difference(x, y, inserter(expected, expected.end()));
+        check_equal(bx ^ by, expected, "symmetric difference" + names);
+
+        check(bx.is_subset_of(by) == ranges::includes(y, x), "is_subset_of()" + names);
+        check((bx == by) == (x == y), "==" + names);
+
+        for(size_t value: boundary_values)
+            check(bx.contains(value) == x.contains(value), "contains(" + std::to_string(value) + ") of " + to_string(x));
+    }
+
+    if(failures != 0)
+        return 1;
+
+    cout << "DynamicBitset checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1 @@
+../../profile
\ No newline at end of file
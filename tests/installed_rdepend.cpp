@@ -0,0 +1,59 @@
+#include <iostream>
+#include <string>
+
+#include "quantum-resolver/database.h"
+#include "quantum-resolver/resolver.h"
+
+using namespace std;
+
+// Runs on tests/fixtures/installed_rdepend through QUANTUM_ROOT: app-misc/app-1 and dev-libs/lib-1
+// are installed, app-1 needs <dev-libs/lib-2 at run time. app-misc/new-1, in @world but not installed,
+// needs >=dev-libs/lib-2, which app-misc/app-2 accepts. An installed ebuild needs its RDEPEND as much
+// as a new one: @world has to upgrade app-misc/app rather than leave app-1 with lib-2
+
+int main()
+{
+    Database db(Database::LoadMode::FULL);
+
+    vector<PackageDependency> atoms;
+    for(PackageID pkg_id: db.repo.get_selected_pkgs())
+    {
+        PackageDependency atom;
+        atom.pkg_constraint.pkg_id = pkg_id;
+        atoms.push_back(std::move(atom));
+    }
+
+    Resolver resolver(&db);
+    Resolution resolution = resolver.resolve(atoms);
+    if(not resolution.solved)
+    {
+        cout << "FAILED: @world has no solution" << endl;
+        return 1;
+    }
+
+    bool app_1 = false, app_2 = false, lib_2 = false;
+    for(const ResolvedEbuild &resolved: resolution.ebuilds)
+    {
+        Package &pkg = db.repo[resolved.pkg_id];
+        const string name = pkg.get_pkg_groupname() + "-" + pkg[resolved.ebuild_id].get_version().string();
+        cout << "  " << name << endl;
+
+        app_1 = app_1 or name == "app-misc/app-1";
+        app_2 = app_2 or name == "app-misc/app-2";
+        lib_2 = lib_2 or name == "dev-libs/lib-2";
+    }
+
+    if(app_1 and lib_2)
+    {
+        cout << "FAILED: dev-libs/lib-2 breaks the RDEPEND of the installed app-misc/app-1" << endl;
+        return 1;
+    }
+
+    if(not app_2 or not lib_2)
+    {
+        cout << "FAILED: app-misc/app-2 and dev-libs/lib-2 should be selected" << endl;
+        return 1;
+    }
+
+    return 0;
+}
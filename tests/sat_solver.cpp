@@ -0,0 +1,190 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "quantum-resolver/utils/sat_solver.h"
+
+using namespace std;
+
+// Checks SatSolver on instances whose answer is known: pigeonhole problems, and small random
+// 3-SAT instances with at-most-one groups, answered by brute force. Every model returned has to
+// satisfy every clause and every group given to the solver
+
+using Lit = SatSolver::Lit;
+using Var = SatSolver::Var;
+
+struct Instance
+{
+    size_t vars_count = 0;
+    vector<vector<Lit>> clauses;
+    vector<vector<Lit>> at_most_one;
+};
+
+bool satisfies(const Instance &instance, auto &&value_of)
+{
+    for(const auto &clause: instance.clauses)
+    {
+        bool satisfied = false;
+        for(Lit lit: clause)
+            satisfied = satisfied or value_of(lit);
+        if(not satisfied)
+            return false;
+    }
+
+    for(const auto &group: instance.at_most_one)
+    {
+        size_t true_count = 0;
+        for(Lit lit: group)
+            true_count += value_of(lit);
+        if(true_count > 1)
+            return false;
+    }
+
+    return true;
+}
+
+/// \brief solves 'instance', checks the model if there is one
+/// \return whether 'instance' is satisfiable, according to SatSolver
+bool solve(const Instance &instance, const string &name, size_t &failures)
+{
+    SatSolver solver;
+    for(size_t i = 0 ; i < instance.vars_count ; i++)
+        solver.new_var();
+    for(const auto &clause: instance.clauses)
+        solver.add_clause(clause);
+    for(const auto &group: instance.at_most_one)
+        solver.add_at_most_one(group);
+
+    if(solver.solve() == SatSolver::Result::UNSATISFIABLE)
+        return false;
+
+    if(not satisfies(instance, [&solver](Lit lit) { return solver.value_of(lit); }))
+    {
+        cout << "FAILED: " << name << ": the model does not satisfy the instance" << endl;
+        failures++;
+    }
+    return true;
+}
+
+bool brute_force(const Instance &instance)
+{
+    for(uint64_t model = 0 ; model < (uint64_t(1) << instance.vars_count) ; model++)
+    {
+        auto value_of = [model](Lit lit) { return bool((model >> SatSolver::var_of(lit)) & 1) != SatSolver::is_negated(lit); };
+        if(satisfies(instance, value_of))
+            return true;
+    }
+    return false;
+}
+
+/// \brief 'pigeons' pigeons in 'holes' holes, no two pigeons in the same hole
+/// \param amo: whether the holes get add_at_most_one() groups rather than binary clauses
+Instance pigeonhole(size_t pigeons, size_t holes, bool amo)
+{
+    Instance instance;
+    instance.vars_count = pigeons * holes;
+    auto in = [holes](size_t pigeon, size_t hole) { return SatSolver::pos(Var(pigeon * holes + hole)); };
+
+    for(size_t pigeon = 0 ; pigeon < pigeons ; pigeon++)
+    {
+        vector<Lit> somewhere;
+        for(size_t hole = 0 ; hole < holes ; hole++)
+            somewhere.push_back(in(pigeon, hole));
+        instance.clauses.push_back(std::move(somewhere));
+    }
+
+    for(size_t hole = 0 ; hole < holes ; hole++)
+    {
+        vector<Lit> group;
+        for(size_t pigeon = 0 ; pigeon < pigeons ; pigeon++)
+            group.push_back(in(pigeon, hole));
+
+        if(amo)
+            instance.at_most_one.push_back(std::move(group));
+        else for(size_t i = 0 ; i < group.size() ; i++)
+            for(size_t j = i + 1 ; j < group.size() ; j++)
+                instance.clauses.push_back({SatSolver::negate(group[i]), SatSolver::negate(group[j])});
+    }
+
+    return instance;
+}
+
+// mt19937 gives the same sequence everywhere, the standard distributions do not
+Instance random_3sat(mt19937 &rng, size_t vars_count, size_t clauses_count, size_t groups_count)
+{
+    Instance instance;
+    instance.vars_count = vars_count;
+    auto random_lit = [&rng, vars_count]() { return Lit(rng() % (2 * vars_count)); };
+
+    for(size_t i = 0 ; i < clauses_count ; i++)
+        instance.clauses.push_back({random_lit(), random_lit(), random_lit()});
+
+    for(size_t i = 0 ; i < groups_count ; i++)
+    {
+        vector<Lit> group(2 + rng() % 8);
+        for(Lit &lit: group)
+            lit = random_lit();
+        instance.at_most_one.push_back(std::move(group));
+    }
+
+    return instance;
+}
+
+int main()
+{
+    size_t failures = 0;
+    auto expect = [&failures](bool satisfiable, bool expected, const string &name)
+    {
+        if(satisfiable != expected)
+        {
+            cout << "FAILED: " << name << " should be " << (expected ? "SAT" : "UNSAT") << endl;
+            failures++;
+        }
+    };
+
+    // pigeons > 6 go through the sequential counter of add_at_most_one()
+    for(size_t holes = 1 ; holes <= 7 ; holes++)
+        for(bool amo: {false, true})
+        {
+            const string name = "pigeonhole " + to_string(holes + 1) + "/" + to_string(holes) + (amo ? " amo" : "");
+            expect(solve(pigeonhole(holes + 1, holes, amo), name, failures), false, name);
+
+            const string fit_name = "pigeonhole " + to_string(holes) + "/" + to_string(holes) + (amo ? " amo" : "");
+            expect(solve(pigeonhole(holes, holes, amo), fit_name, failures), true, fit_name);
+        }
+
+    // trivial cases: empty clause, x and ~x, no clause at all
+    expect(solve({1, {{}}, {}}, "empty clause", failures), false, "empty clause");
+    expect(solve({1, {{SatSolver::pos(0)}, {SatSolver::neg(0)}}, {}}, "x and ~x", failures), false, "x and ~x");
+    expect(solve({3, {}, {}}, "no clause", failures), true, "no clause");
+
+    // around 4.2 clauses per variable, close to the threshold: both SAT and UNSAT instances come up
+    mt19937 rng(2024);
+    size_t sat_count = 0, unsat_count = 0;
+    for(size_t i = 0 ; i < 400 ; i++)
+    {
+        Instance instance = random_3sat(rng, 14, 56 + rng() % 8, rng() % 3);
+        const string name = "random 3-SAT #" + to_string(i);
+        bool expected = brute_force(instance);
+        expect(solve(instance, name, failures), expected, name);
+        (expected ? sat_count : unsat_count)++;
+    }
+
+    // too large for brute force, only the models get checked
+    for(size_t i = 0 ; i < 50 ; i++)
+        solve(random_3sat(rng, 200, 800, 20), "large random 3-SAT #" + to_string(i), failures);
+
+    if(sat_count == 0 or unsat_count == 0)
+    {
+        cout << "FAILED: the random instances should be both SAT and UNSAT" << endl;
+        failures++;
+    }
+
+    if(failures != 0)
+        return 1;
+
+    cout << "SAT solver checks passed (" << sat_count << " SAT, " << unsat_count << " UNSAT random instances)" << endl;
+    return 0;
+}
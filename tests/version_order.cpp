@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "quantum-resolver/core/ebuild_version.h"
+
+using namespace std;
+
+// The version order of PMS (algorithms 3.1 to 3.7), checked on the packed keys of EbuildVersion
+
+// every version comes strictly before the next one
+const vector<vector<string>> increasing_chains =
+{
+    {"1.0_alpha", "1.0_alpha1", "1.0_beta", "1.0_pre", "1.0_rc1", "1.0", "1.0-r1", "1.0-r2", "1.0_p1", "1.0a", "1.0.1"},
+    {"1.0_alpha_p1", "1.0_alpha1", "1.0_beta_alpha", "1.0_beta", "1.0", "1.0_p1_alpha", "1.0_p1", "1.0_p1_p1"},
+    {"1", "1.0", "1.0.0", "1.0.0.1", "1.1", "1.2", "1.10", "2", "10", "9999"},
+    {"1.001", "1.01", "1.0101", "1.02", "1.1", "1.2"},
+    {"1.0a", "1.0.01", "1.0.1"},
+    {"2.38", "2.38a", "2.38z", "2.39"},
+    {"1-r9", "1-r10", "1-r100", "1.0_p"},
+    {"4294967295", "4294967296", "18446744073709551615", "18446744073709551616", "99999999999999999999", "100000000000000000000"},
+    {"1.18446744073709551615", "1.18446744073709551616", "1.123456789012345678901234567890", "2"},
+    {"1_p20230121", "1_p20230121-r1", "1_p123456789012345678901234"},
+};
+
+// every version is equal to the other ones of its group
+const vector<vector<string>> equal_groups =
+{
+    {"1.0", "1.0-r0", "1.0-r00"},
+    {"1.01", "1.010", "1.0100"},
+    {"1.0", "1.00", "1.000"},
+    {"01.1", "1.1", "001.1"},
+    {"1.0_p", "1.0_p0"},
+    {"1_p018446744073709551616", "1_p18446744073709551616"},
+};
+
+int main()
+{
+    size_t failures = 0;
+    auto check = [&failures](bool result, const string &a, const char *op, const string &b)
+    {
+        if(not result)
+        {
+            cout << "FAILED: " << a << " " << op << " " << b << endl;
+            failures++;
+        }
+    };
+
+    for(const auto &chain: increasing_chains)
+        for(size_t i = 0 ; i < chain.size() ; i++)
+            for(size_t j = i + 1 ; j < chain.size() ; j++)
+            {
+                EbuildVersion a(chain[i]), b(chain[j]);
+                check(a < b and a <= b and b > a and b >= a and not (a == b), chain[i], "<", chain[j]);
+            }
+
+    for(const auto &group: equal_groups)
+        for(size_t i = 0 ; i < group.size() ; i++)
+            for(size_t j = 0 ; j < group.size() ; j++)
+            {
+                EbuildVersion a(group[i]), b(group[j]);
+                check(a == b and a <= b and a >= b and not (a < b) and not (a > b), group[i], "==", group[j]);
+            }
+
+    // ~ ignores the revision, =* wants the given components first
+    check(EbuildVersion("1.0-r3") ^= EbuildVersion("1.0"), "1.0-r3", "~", "1.0");
+    check(not (EbuildVersion("1.0.1") ^= EbuildVersion("1.0")), "not 1.0.1", "~", "1.0");
+    check(EbuildVersion("1.2.3") *= EbuildVersion("1.2"), "1.2.3", "=*", "1.2");
+    check(not (EbuildVersion("1.3") *= EbuildVersion("1.2")), "not 1.3", "=*", "1.2");
+
+    for(const char *invalid: {"1.", ".1", "1..2", "1_foo", "1-r", "1ab", "1.0-r1a", "a1"})
+    {
+        bool thrown = false;
+        try
+        {
+            EbuildVersion version(invalid);
+        }
+        catch(const runtime_error&)
+        {
+            thrown = true;
+        }
+        check(thrown, invalid, "is", "invalid");
+    }
+
+    if(failures != 0)
+        return 1;
+
+    cout << "Version order checks passed" << endl;
+    return 0;
+}